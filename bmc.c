@@ -26,15 +26,16 @@ void initData(PtpClock *ptpClock)
 	/* Default data set */
 	ptpClock->defaultDS.twoStepFlag = DEFAULT_TWO_STEP_FLAG;
 
-	/* Init clockIdentity with MAC address and 0xFF and 0xFE. see spec 7.5.2.2.2 */
+	/* Init clockIdentity with MAC address and 0xFF and 0xFE. see spec 7.5.2.2.2
+	 * All the ports of a boundary clock take the identity of port 1 */
 	if ((CLOCK_IDENTITY_LENGTH == 8) && (PTP_UUID_LENGTH == 6))
 	{
 			DBGVV("initData: EUI48toEUI64\n");
-			EUI48toEUI64(ptpClock->portUuidField, ptpClock->defaultDS.clockIdentity);
+			EUI48toEUI64(ptpClock->ports->portUuidField, ptpClock->defaultDS.clockIdentity);
 	}
 	else if (CLOCK_IDENTITY_LENGTH == PTP_UUID_LENGTH)
 	{
-			memcpy(ptpClock->defaultDS.clockIdentity, ptpClock->portUuidField, CLOCK_IDENTITY_LENGTH);
+			memcpy(ptpClock->defaultDS.clockIdentity, ptpClock->ports->portUuidField, CLOCK_IDENTITY_LENGTH);
 	}
 	else
 	{
@@ -57,7 +58,7 @@ void initData(PtpClock *ptpClock)
 
 	/* PortIdentity Init (portNumber = 1 for an ardinary clock spec 7.5.2.3)*/
 	memcpy(ptpClock->portDS.portIdentity.clockIdentity, ptpClock->defaultDS.clockIdentity, CLOCK_IDENTITY_LENGTH);
-	ptpClock->portDS.portIdentity.portNumber = NUMBER_PORTS;
+	ptpClock->portDS.portIdentity.portNumber = rtOpts->portNumber;
 	ptpClock->portDS.logMinDelayReqInterval = DEFAULT_DELAYREQ_INTERVAL;
 	ptpClock->portDS.peerMeanPathDelay.seconds = ptpClock->portDS.peerMeanPathDelay.nanoseconds = 0;
 	ptpClock->portDS.logAnnounceInterval = rtOpts->announceInterval;
@@ -68,7 +69,7 @@ void initData(PtpClock *ptpClock)
 	ptpClock->portDS.versionNumber = VERSION_PTP;
 
 	/* Init other stuff */
-	ptpClock->foreignMasterDS.count = 0;
+	clearForeign(ptpClock);
 	ptpClock->foreignMasterDS.capacity = rtOpts->maxForeignRecords;
 
 	ptpClock->inboundLatency = rtOpts->inboundLatency;
@@ -89,52 +90,326 @@ bool isSamePortIdentity(const PortIdentity * A, const PortIdentity * B)
 	return (bool)(0 == memcmp(A->clockIdentity, B->clockIdentity, CLOCK_IDENTITY_LENGTH) && (A->portNumber == B->portNumber));
 }
 
-void addForeign(PtpClock *ptpClock, const MsgHeader *header, const MsgAnnounce * announce)
+/* FNV-1a of the 10 bytes of the port identity, folded to 16 bits */
+uint16_t hashPortIdentity(const PortIdentity *portIdentity)
 {
-	int i, j;
-	bool found = FALSE;
+	uint32_t hash = 2166136261u;
+	int16_t i;
+
+	for (i = 0; i < CLOCK_IDENTITY_LENGTH; i++)
+	{
+		hash = (hash ^ portIdentity->clockIdentity[i]) * 16777619u;
+	}
 
-	j = ptpClock->foreignMasterDS.best;
+	hash = (hash ^ (portIdentity->portNumber >> 8)) * 16777619u;
+	hash = (hash ^ (portIdentity->portNumber & 0xFF)) * 16777619u;
 
-	/* Check if Foreign master is already known */
-	for (i = 0; i < ptpClock->foreignMasterDS.count; i++)
+	return (uint16_t)(hash ^ (hash >> 16));
+}
+
+/* Announce messages older than the foreign master time window (9.3.2.4.4) */
+static uint32_t foreignWindow(const PtpClock *ptpClock)
+{
+	return DEFAULT_FOREIGN_MASTER_TIME_WINDOW * pow2ms(ptpClock->portDS.logAnnounceInterval);
+}
+
+static uint16_t foreignHash(const PortIdentity *portIdentity)
+{
+	return hashPortIdentity(portIdentity) & FOREIGN_HASH_MASK;
+}
+
+/* Record of a port, -1 for none */
+static int16_t foreignFind(const ForeignMasterDS *ds, const PortIdentity *portIdentity)
+{
+	int16_t j;
+
+	for (j = ds->buckets[foreignHash(portIdentity)]; j >= 0; j = ds->records[j].chain)
 	{
-		if (isSamePortIdentity(&header->sourcePortIdentity, &ptpClock->foreignMasterDS.records[j].foreignMasterPortIdentity))
+		if (isSamePortIdentity(portIdentity, &ds->records[j].foreignMasterPortIdentity)) break;
+	}
+
+	return j;
+}
+
+static void foreignHashInsert(ForeignMasterDS *ds, int16_t j)
+{
+	uint16_t bucket = foreignHash(&ds->records[j].foreignMasterPortIdentity);
+
+	ds->records[j].chain = ds->buckets[bucket];
+	ds->buckets[bucket] = j;
+}
+
+static void foreignHashRemove(ForeignMasterDS *ds, int16_t j)
+{
+	int16_t *link = &ds->buckets[foreignHash(&ds->records[j].foreignMasterPortIdentity)];
+
+	while (*link != j) link = &ds->records[*link].chain;
+	*link = ds->records[j].chain;
+}
+
+/* Take a record out of the order of the last Announce */
+static void foreignUnlink(ForeignMasterDS *ds, int16_t j)
+{
+	ForeignMasterRecord *record = &ds->records[j];
+
+	if (record->newer >= 0) ds->records[record->newer].older = record->older;
+	else ds->newest = record->older;
+
+	if (record->older >= 0) ds->records[record->older].newer = record->newer;
+	else ds->oldest = record->newer;
+}
+
+/* Put a record first in the order of the last Announce */
+static void foreignPushNewest(ForeignMasterDS *ds, int16_t j)
+{
+	ds->records[j].newer = -1;
+	ds->records[j].older = ds->newest;
+
+	if (ds->newest >= 0) ds->records[ds->newest].newer = j;
+	else ds->oldest = j;
+
+	ds->newest = j;
+}
+
+/* Remove a record, the last one takes its place to keep them packed from 0 to count - 1 */
+static void foreignDrop(ForeignMasterDS *ds, int16_t j)
+{
+	int16_t last;
+
+	foreignUnlink(ds, j);
+	foreignHashRemove(ds, j);
+	last = --ds->count;
+	ds->changed = TRUE;
+	if (ds->worst == j) ds->worst = -1;
+	if (ds->best == j) ds->best = -1;
+
+	if (j == last) return;
+
+	foreignHashRemove(ds, last);
+	ds->records[j] = ds->records[last];
+	foreignHashInsert(ds, j);
+	if (ds->worst == last) ds->worst = j;
+	if (ds->best == last) ds->best = j;
+
+	if (ds->records[j].newer >= 0) ds->records[ds->records[j].newer].older = j;
+	else ds->newest = j;
+
+	if (ds->records[j].older >= 0) ds->records[ds->records[j].older].newer = j;
+	else ds->oldest = j;
+}
+
+/* Keep worst the lowest ranked record after record j changed, without a search */
+static void foreignRank(PtpClock *ptpClock, int16_t j)
+{
+	ForeignMasterDS *ds = &ptpClock->foreignMasterDS;
+
+	if (ds->worst == j) ds->worst = -1;
+
+	if (ds->worst >= 0 && bmcDataSetComparison(&ds->records[j].header, &ds->records[j].announce,
+			&ds->records[ds->worst].header, &ds->records[ds->worst].announce, ptpClock) < 0)
+	{
+		ds->worst = j;
+	}
+}
+
+/* The lowest ranked record, searched only when not known */
+static int16_t foreignWorst(PtpClock *ptpClock)
+{
+	ForeignMasterDS *ds = &ptpClock->foreignMasterDS;
+	int16_t j;
+
+	if (ds->worst >= 0) return ds->worst;
+
+	for (j = 0; j < ds->count; j++)
+	{
+		if (ds->worst < 0 || bmcDataSetComparison(&ds->records[j].header, &ds->records[j].announce,
+				&ds->records[ds->worst].header, &ds->records[ds->worst].announce, ptpClock) < 0)
 		{
-			/* Foreign Master is already in Foreignmaster data set */
-			ptpClock->foreignMasterDS.records[j].foreignMasterAnnounceMessages++;
-			found = TRUE;
-			DBGV("addForeign: AnnounceMessage incremented \n");
-			ptpClock->foreignMasterDS.records[j].header = *header;
-			ptpClock->foreignMasterDS.records[j].announce = *announce;
-			break;
+			ds->worst = j;
 		}
+	}
+
+	return ds->worst;
+}
+
+void clearForeign(PtpClock *ptpClock)
+{
+	int16_t i;
+
+	ptpClock->foreignMasterDS.count = 0;
+	ptpClock->foreignMasterDS.newest = -1;
+	ptpClock->foreignMasterDS.oldest = -1;
+	ptpClock->foreignMasterDS.worst = -1;
+	ptpClock->foreignMasterDS.best = -1;
+	ptpClock->foreignMasterDS.changed = TRUE;
+
+	for (i = 0; i < FOREIGN_HASH_BUCKETS; i++)
+	{
+		ptpClock->foreignMasterDS.buckets[i] = -1;
+	}
+}
+
+/* The oldest record goes first, each eviction is one step */
+void expireForeign(PtpClock *ptpClock)
+{
+	ForeignMasterDS *ds = &ptpClock->foreignMasterDS;
+	ForeignMasterRecord *record;
+	uint32_t now = timerNow();
+	uint32_t window = foreignWindow(ptpClock);
 
-		j = (j + 1) % ptpClock->foreignMasterDS.count;
+	while (ds->oldest >= 0)
+	{
+		record = &ds->records[ds->oldest];
+		if (now - record->receipts[record->receipt] <= window) break;
+
+		DBGV("expireForeign: record %d expired\n", ds->oldest);
+		foreignDrop(ds, ds->oldest);
 	}
 
-	/* New Foreign Master */
-	if (!found)
+	/* Erbest may also leave the time window before it expires */
+	if (ds->best >= 0 && !isQualifiedForeign(ptpClock, &ds->records[ds->best]))
 	{
-		if (ptpClock->foreignMasterDS.count < ptpClock->foreignMasterDS.capacity)
+		ds->best = -1;
+		ds->changed = TRUE;
+	}
+}
+
+/* FOREIGN_MASTER_THRESHOLD Announce messages within the time window (9.3.2.4.4) */
+bool isQualifiedForeign(const PtpClock *ptpClock, const ForeignMasterRecord *record)
+{
+	uint8_t first = (record->receipt + 1) % DEFAULT_FOREIGN_MASTER_THRESHOLD;
+
+	/* The counter starts at 0 on the first Announce */
+	if (record->foreignMasterAnnounceMessages + 1 < DEFAULT_FOREIGN_MASTER_THRESHOLD) return FALSE;
+
+	return (bool)(timerNow() - record->receipts[first] <= foreignWindow(ptpClock));
+}
+
+/* The fields of the Announce which the data set comparison uses (9.3.4) */
+static bool foreignSameDataSet(const MsgAnnounce *a, const MsgAnnounce *b)
+{
+	return (bool)(a->grandmasterPriority1 == b->grandmasterPriority1 &&
+			a->grandmasterClockQuality.clockClass == b->grandmasterClockQuality.clockClass &&
+			a->grandmasterClockQuality.clockAccuracy == b->grandmasterClockQuality.clockAccuracy &&
+			a->grandmasterClockQuality.offsetScaledLogVariance == b->grandmasterClockQuality.offsetScaledLogVariance &&
+			a->grandmasterPriority2 == b->grandmasterPriority2 &&
+			a->stepsRemoved == b->stepsRemoved &&
+			!memcmp(a->grandmasterIdentity, b->grandmasterIdentity, CLOCK_IDENTITY_LENGTH));
+}
+
+/* Keep Erbest after an Announce of record j, a state decision is needed only if it changed */
+static void foreignBest(PtpClock *ptpClock, int16_t j, bool wasQualified, bool sameDataSet)
+{
+	ForeignMasterDS *ds = &ptpClock->foreignMasterDS;
+
+	if (!isQualifiedForeign(ptpClock, &ds->records[j]))
+	{
+		if (j == ds->best) ds->best = -1;
+		if (wasQualified) ds->changed = TRUE;
+		return;
+	}
+
+	/* Erbest may have become worse than another record, search again */
+	if (j == ds->best)
+	{
+		if (!sameDataSet)
 		{
-			ptpClock->foreignMasterDS.count++;
+			ds->best = -1;
+			ds->changed = TRUE;
 		}
+		return;
+	}
 
-		j = ptpClock->foreignMasterDS.i;
+	/* A new or a changed candidate, for the standby and the ensemble too */
+	if (!wasQualified || !sameDataSet) ds->changed = TRUE;
 
-		/* Copy new foreign master data set from Announce message */
-		memcpy(ptpClock->foreignMasterDS.records[j].foreignMasterPortIdentity.clockIdentity, header->sourcePortIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH);
-		ptpClock->foreignMasterDS.records[j].foreignMasterPortIdentity.portNumber = header->sourcePortIdentity.portNumber;
-		ptpClock->foreignMasterDS.records[j].foreignMasterAnnounceMessages = 0;
+	if (ds->best >= 0 && bmcDataSetComparison(&ds->records[j].header, &ds->records[j].announce,
+			&ds->records[ds->best].header, &ds->records[ds->best].announce, ptpClock) > 0)
+	{
+		ds->best = j;
+		ds->changed = TRUE;
+	}
+}
 
-		/* Header and announce field of each Foreign Master are usefull to run Best Master Clock Algorithm */
-		ptpClock->foreignMasterDS.records[j].header = *header;
-		ptpClock->foreignMasterDS.records[j].announce = *announce;
-		DBGV("addForeign: New foreign Master added \n");
+void addForeign(PtpClock *ptpClock, const MsgHeader *header, const MsgAnnounce * announce)
+{
+	ForeignMasterDS *ds = &ptpClock->foreignMasterDS;
+	ForeignMasterRecord *record;
+	bool  wasQualified = FALSE;
+	bool  sameDataSet = FALSE;
+	int16_t j;
+
+	ptpClock->bmcStats.announces++;
+	expireForeign(ptpClock);
+
+	/* Check if Foreign master is already known */
+	j = foreignFind(ds, &header->sourcePortIdentity);
 
-		ptpClock->foreignMasterDS.i = (ptpClock->foreignMasterDS.i + 1) % ptpClock->foreignMasterDS.capacity;
+	if (j >= 0)
+	{
+		/* Foreign Master is already in Foreignmaster data set */
+		record = &ds->records[j];
+		wasQualified = isQualifiedForeign(ptpClock, record);
+		sameDataSet = foreignSameDataSet(&record->announce, announce);
+		if (record->foreignMasterAnnounceMessages < INT16_MAX) record->foreignMasterAnnounceMessages++;
+		record->receipt = (record->receipt + 1) % DEFAULT_FOREIGN_MASTER_THRESHOLD;
+		DBGV("addForeign: AnnounceMessage incremented \n");
+		foreignUnlink(ds, j);
 	}
+	else
+	{
+		/* New Foreign Master, in a free record or in place of the lowest ranked one if it is better */
+		if (ds->count < ds->capacity)
+		{
+			j = ds->count++;
+		}
+		else
+		{
+			j = foreignWorst(ptpClock);
+			if (bmcDataSetComparison((MsgHeader*) header, (MsgAnnounce*) announce,
+					&ds->records[j].header, &ds->records[j].announce, ptpClock) <= 0)
+			{
+				DBGV("addForeign: table full, new foreign Master ignored \n");
+				return;
+			}
+
+			foreignUnlink(ds, j);
+			foreignHashRemove(ds, j);
+			ds->worst = -1;
+			if (ds->best == j)
+			{
+				ds->best = -1;
+				ds->changed = TRUE;
+			}
+		}
+
+		record = &ds->records[j];
+		memcpy(record->foreignMasterPortIdentity.clockIdentity, header->sourcePortIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH);
+		record->foreignMasterPortIdentity.portNumber = header->sourcePortIdentity.portNumber;
+		record->foreignMasterAnnounceMessages = 0;
+		record->receipt = 0;
+		foreignHashInsert(ds, j);
+		DBGV("addForeign: New foreign Master added \n");
+	}
+
+	/* Header and announce field of each Foreign Master are usefull to run Best Master Clock Algorithm */
+	record->header = *header;
+	record->announce = *announce;
+	record->receipts[record->receipt] = timerNow();
+	foreignPushNewest(ds, j);
+	foreignRank(ptpClock, j);
+	foreignBest(ptpClock, j, wasQualified, sameDataSet);
+}
+
+/* Forget a foreign master */
+void removeForeign(PtpClock *ptpClock, const PortIdentity *portIdentity)
+{
+	int16_t j = foreignFind(&ptpClock->foreignMasterDS, portIdentity);
+
+	if (j < 0) return;
+
+	DBGV("removeForeign: record %d removed\n", j);
+	foreignDrop(&ptpClock->foreignMasterDS, j);
 }
 
 #define m2 m1
@@ -161,13 +436,13 @@ void m1(PtpClock *ptpClock)
 
 	/* Time Properties data set */
 	ptpClock->timePropertiesDS.currentUtcOffset = ptpClock->rtOpts->currentUtcOffset;
-	ptpClock->timePropertiesDS.currentUtcOffsetValid = DEFAULT_UTC_VALID;
+	ptpClock->timePropertiesDS.currentUtcOffsetValid = ptpClock->rtOpts->currentUtcOffsetValid;
 	ptpClock->timePropertiesDS.leap59 = FALSE;
 	ptpClock->timePropertiesDS.leap61 = FALSE;
-	ptpClock->timePropertiesDS.timeTraceable = DEFAULT_TIME_TRACEABLE;
-	ptpClock->timePropertiesDS.frequencyTraceable = DEFAULT_FREQUENCY_TRACEABLE;
-	ptpClock->timePropertiesDS.ptpTimescale = (bool)(DEFAULT_TIMESCALE == PTP_TIMESCALE);
-	ptpClock->timePropertiesDS.timeSource = DEFAULT_TIME_SOURCE;
+	ptpClock->timePropertiesDS.timeTraceable = ptpClock->rtOpts->timeTraceable;
+	ptpClock->timePropertiesDS.frequencyTraceable = ptpClock->rtOpts->frequencyTraceable;
+	ptpClock->timePropertiesDS.ptpTimescale = ptpClock->rtOpts->ptpTimescale;
+	ptpClock->timePropertiesDS.timeSource = ptpClock->rtOpts->timeSource;
 }
 
 void p1(PtpClock *ptpClock)
@@ -229,8 +504,8 @@ void copyD0(MsgHeader *header, MsgAnnounce *announce, PtpClock *ptpClock)
 }
 
 
-#define A_better_then_B 1
-#define B_better_then_A -1
+#define A_better_then_B 2
+#define B_better_then_A -2
 #define A_better_by_topology_then_B 1
 #define B_better_by_topology_then_A -1
 #define ERROR_1 0
@@ -247,7 +522,8 @@ void copyD0(MsgHeader *header, MsgAnnounce *announce, PtpClock *ptpClock)
 		return A_better_then_B;                                             \
 	}                                                                     \
 
-/* Data set comparison bewteen two foreign masters (9.3.4 fig 27) return similar to memcmp() */
+/* Data set comparison bewteen two foreign masters (9.3.4 fig 27), positive when A is better than B,
+ * negative when B is better, 2 by the data sets and 1 by topology only */
 int8_t bmcDataSetComparison(MsgHeader *headerA, MsgAnnounce *announceA,
 															MsgHeader *headerB, MsgAnnounce *announceB, PtpClock *ptpClock)
 {
@@ -376,7 +652,7 @@ uint8_t bmcStateDecision(MsgHeader *header, MsgAnnounce *announce, PtpClock *ptp
 
 	if (ptpClock->defaultDS.clockQuality.clockClass < 128)
 	{
-		if (A_better_then_B == comp)
+		if (comp > 0)
 		{
 			m1(ptpClock);  /* M1 */
 			return PTP_MASTER;
@@ -389,7 +665,7 @@ uint8_t bmcStateDecision(MsgHeader *header, MsgAnnounce *announce, PtpClock *ptp
 	}
 	else
 	{
-		if (A_better_then_B == comp)
+		if (comp > 0)
 		{
 			m2(ptpClock); /* M2 */
 			return PTP_MASTER;
@@ -404,15 +680,25 @@ uint8_t bmcStateDecision(MsgHeader *header, MsgAnnounce *announce, PtpClock *ptp
 
 
 
-uint8_t bmc(PtpClock *ptpClock)
+/* Select Erbest, the best qualified foreign master of the port, -1 for none */
+static int16_t bmcBest(PtpClock *ptpClock)
 {
 	int16_t i, best;
 
-	/* Starting from i = 1, not necessery to test record[i = 0] against record[best = 0] -> they are the same */
-	for (i = 1, best = 0; i < ptpClock->foreignMasterDS.count; i++)
+	expireForeign(ptpClock);
+
+	/* Kept by addForeign, searched again when dropped or out of the time window */
+	best = ptpClock->foreignMasterDS.best;
+	if (best >= 0 && isQualifiedForeign(ptpClock, &ptpClock->foreignMasterDS.records[best])) return best;
+
+	ptpClock->bmcStats.searches++;
+
+	for (i = 0, best = -1; i < ptpClock->foreignMasterDS.count; i++)
 	{
-		if ((bmcDataSetComparison(&ptpClock->foreignMasterDS.records[i].header, &ptpClock->foreignMasterDS.records[i].announce,
-															&ptpClock->foreignMasterDS.records[best].header, &ptpClock->foreignMasterDS.records[best].announce, ptpClock)) < 0)
+		if (!isQualifiedForeign(ptpClock, &ptpClock->foreignMasterDS.records[i])) continue;
+
+		if (best < 0 || (bmcDataSetComparison(&ptpClock->foreignMasterDS.records[i].header, &ptpClock->foreignMasterDS.records[i].announce,
+															&ptpClock->foreignMasterDS.records[best].header, &ptpClock->foreignMasterDS.records[best].announce, ptpClock)) > 0)
 		{
 			best = i;
 		}
@@ -421,7 +707,140 @@ uint8_t bmc(PtpClock *ptpClock)
 	DBGV("bmc: best record %d\n", best);
 	ptpClock->foreignMasterDS.best = best;
 
+	return best;
+}
+
+#ifdef PTPD_BOUNDARY_CLOCK
+
+/* Copy the data sets learned from Ebest to another port of the clock */
+static void copyParent(PtpClock *to, const PtpClock *from)
+{
+	if (to == from) return;
+
+	to->currentDS.stepsRemoved = from->currentDS.stepsRemoved;
+	to->parentDS = from->parentDS;
+	to->timePropertiesDS = from->timePropertiesDS;
+}
+
+static bool isPortActive(const PtpClock *port)
+{
+	switch (port->portDS.portState)
+	{
+		case PTP_INITIALIZING:
+		case PTP_FAULTY:
+		case PTP_DISABLED:
+			return FALSE;
+		default:
+			return TRUE;
+	}
+}
+
+/* State decision algorithm of a boundary clock port 9.3.3 Fig 26, Ebest is
+ * the best of the Erbest of all the ports */
+static uint8_t bmcPortStateDecision(PtpClock *ptpClock)
+{
+	PtpClock *port, *ebestPort = NULL;
+	ForeignMasterRecord *record, *erbest = NULL, *ebest = NULL;
+	uint8_t state;
+	int16_t i, best;
+
+	for (i = 0; i < NUMBER_PORTS; i++)
+	{
+		port = &ptpClock->ports[i];
+
+		if (!isPortActive(port) || (best = bmcBest(port)) < 0) continue;
+
+		record = &port->foreignMasterDS.records[best];
+		if (port == ptpClock) erbest = record;
+
+		/* On a tie the port with the lower number wins */
+		if (ebest == NULL || bmcDataSetComparison(&record->header, &record->announce, &ebest->header, &ebest->announce, ptpClock) > 0)
+		{
+			ebest = record;
+			ebestPort = port;
+		}
+	}
+
+	copyD0(&ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce, ptpClock);
+
+	if (ptpClock->defaultDS.clockQuality.clockClass < 128)
+	{
+		if (erbest == NULL || bmcDataSetComparison(&ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce, &erbest->header, &erbest->announce, ptpClock) > 0)
+		{
+			m1(ptpClock); /* M1 */
+			state = PTP_MASTER;
+		}
+		else
+		{
+			p1(ptpClock); /* P1 */
+			state = PTP_PASSIVE;
+		}
+	}
+	else if (ebest == NULL || bmcDataSetComparison(&ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce, &ebest->header, &ebest->announce, ptpClock) > 0)
+	{
+		m1(ptpClock); /* M2 */
+		state = PTP_MASTER;
+	}
+	else if (ebestPort == ptpClock)
+	{
+		s1(ptpClock, &ebest->header, &ebest->announce);
+
+		/* The other ports announce what this port receives */
+		for (i = 0; i < NUMBER_PORTS; i++)
+		{
+			copyParent(&ptpClock->ports[i], ptpClock);
+		}
+
+		state = PTP_SLAVE;
+	}
+	else if (erbest != NULL && bmcDataSetComparison(&ebest->header, &ebest->announce, &erbest->header, &erbest->announce, ptpClock) == A_better_by_topology_then_B)
+	{
+		DBGV("bmc: p2\n"); /* P2 */
+		state = PTP_PASSIVE;
+	}
+	else
+	{
+		DBGV("bmc: m3\n"); /* M3 */
+		copyParent(ptpClock, ebestPort);
+		state = PTP_MASTER;
+	}
+
+	/* A port changing its role changes the decision of the others */
+	if (state != ptpClock->recommendedState)
+	{
+		for (i = 0; i < NUMBER_PORTS; i++)
+		{
+			if (&ptpClock->ports[i] != ptpClock && isPortActive(&ptpClock->ports[i]))
+				setFlag(ptpClock->ports[i].events, STATE_DECISION_EVENT);
+		}
+	}
+
+	return state;
+}
+
+#endif
+
+uint8_t bmc(PtpClock *ptpClock)
+{
+#ifdef PTPD_BOUNDARY_CLOCK
+	ptpClock->foreignMasterDS.changed = FALSE;
+	return bmcPortStateDecision(ptpClock);
+#else
+	int16_t best;
+
+	ptpClock->foreignMasterDS.changed = FALSE;
+	best = bmcBest(ptpClock);
+
+	/* Erbest is empty, D0 is better (9.3.3) */
+	if (best < 0)
+	{
+		if (ptpClock->portDS.portState == PTP_LISTENING) return PTP_LISTENING;
+		if (!(ptpClock->defaultDS.slaveOnly || ptpClock->defaultDS.clockQuality.clockClass == 255)) m1(ptpClock);
+		return PTP_MASTER;
+	}
+
 	return bmcStateDecision(&ptpClock->foreignMasterDS.records[best].header, &ptpClock->foreignMasterDS.records[best].announce, ptpClock);
+#endif
 }
 
 
@@ -55,9 +55,21 @@
 #define MAX_ADJ_OFFSET_NS       100000000 /* max offset to try to adjust it < 100ms */
 
 /* features, only change to refelect changes in implementation */
+#if defined(PTPD_BOUNDARY_CLOCK) && defined(PTPD_TRANSPARENT_CLOCK)
+#error "PTPD_BOUNDARY_CLOCK and PTPD_TRANSPARENT_CLOCK are exclusive"
+#endif
+
+#if defined(PTPD_BOUNDARY_CLOCK) || defined(PTPD_TRANSPARENT_CLOCK)
+#define NUMBER_PORTS      PTPD_NUMBER_INSTANCES /* every instance is a port of the clock */
+#else
 #define NUMBER_PORTS      1
-#define VERSION_PTP       2
+#endif
+#ifdef PTPD_BOUNDARY_CLOCK
+#define BOUNDARY_CLOCK    TRUE
+#else
 #define BOUNDARY_CLOCK    FALSE
+#endif
+#define VERSION_PTP       2
 #define SLAVE_ONLY        TRUE
 #define NO_ADJUST         FALSE
 
@@ -75,6 +87,9 @@
 #define PDELAY_RESP_LENGTH            54
 #define PDELAY_RESP_FOLLOW_UP_LENGTH  54
 #define MANAGEMENT_LENGTH             48
+#define SIGNALING_LENGTH              44
+#define TLV_HEADER_LENGTH             4
+#define INTERVAL_REQUEST_LENGTH       12 /* lengthField of the message interval request TLV */
 /** \}*/
 
 /* Enumeration  defined in tables of the spec */
@@ -153,6 +168,8 @@ enum
 	ANNOUNCE_RECEIPT_TIMER,/**<\brief Timer handling announce receipt timeout */
 	ANNOUNCE_INTERVAL_TIMER, /**<\brief Timer handling interval before master sends two announce messages */
 	QUALIFICATION_TIMEOUT,
+	UNICAST_GRANT_TIMER, /**<\brief Timer counting down the unicast grants every second */
+	SYNC_RECEIPT_TIMER, /**<\brief Timer handling sync receipt timeout of a slave */
 	TIMER_ARRAY_SIZE  /* this one is non-spec */
 };
 
@@ -173,6 +190,18 @@ enum
 	MANAGEMENT,
 };
 
+/**
+ * \brief TLV types of unicast negotiation (Table 34)
+ */
+enum
+{
+	ORGANIZATION_EXTENSION = 0x0003, /**< carries the message interval request of 802.1AS */
+	REQUEST_UNICAST_TRANSMISSION = 0x0004,
+	GRANT_UNICAST_TRANSMISSION,
+	CANCEL_UNICAST_TRANSMISSION,
+	ACKNOWLEDGE_CANCEL_UNICAST_TRANSMISSION
+};
+
 /**
  * \brief PTP Messages control field (Table 23)
  */
@@ -46,6 +46,15 @@
 
 #define pow2ms(a) (((a)>0) ? (1000 << (a)) : (1000 >>(-(a))))
 
+/* pow2us(a) = round(pow(2,a)*1000000), the unit of the interval timers */
+
+#define pow2us(a) (((a)>0) ? (1000000u << (a)) : (1000000u >>(-(a))))
+
+/* Shortest message interval, 2^-8 s. A slave at this Sync rate handles 512
+ * Sync and Follow_Up a second, each one copy, one unpack and for the Follow_Up
+ * one servo update; the PTPD_LOADGEN build measures the doState time of a message. */
+#define LOG_INTERVAL_MIN  -8
+
 #define ADJ_FREQ_MAX  64
 
 /* UDP/IPv4 dependent */
@@ -64,10 +73,156 @@
 #define DEFAULT_PTP_DOMAIN_ADDRESS  "224.0.1.129"
 #define PEER_PTP_DOMAIN_ADDRESS     "224.0.0.107"
 
+/* UDP/IPv6 transport (Annex E), groups FF0x::181 with x the scope and FF02::6B */
+#define DEFAULT_IPV6_SCOPE          0x0E /* global */
+#define PTP_IPV6_GROUP_ID           0x181
+#define PTP_IPV6_PEER_GROUP_ID      0x6B
+#define PTP_IPV6_PEER_SCOPE         0x02 /* link-local */
+
+/* IEEE 802.3 transport (Annex F), lwipopts.h must route unknown ethertypes to
+ * netEthernetInput with LWIP_HOOK_UNKNOWN_ETH_PROTOCOL */
+#define DEFAULT_TRANSPORT           UDP_IPV4
+#define PTP_ETHERTYPE               0x88F7
+#define PTP_ETHER_DST               { 0x01, 0x1B, 0x19, 0x00, 0x00, 0x00 }
+#define PTP_ETHER_PEER              { 0x01, 0x80, 0xC2, 0x00, 0x00, 0x0E }
+
 #define MM_STARTING_BOUNDARY_HOPS  0x7fff
 
+/* PPS output */
+
+#define DEFAULT_PPS_INTERVAL_NS   0 /* 0 -> keep the fixed 128 Hz output of ETH_PTPStart */
+#define DEFAULT_PPS_WIDTH_NS      0 /* 0 -> half of the interval */
+#define PPS_START_MARGIN_NS       100000000 /* target time must be programmed ahead of the second boundary */
+
+/* Auxiliary snapshot inputs */
+#define DEFAULT_SNAPSHOT_INPUTS   0 /* bit n enables auxiliary input n */
+
+/* Auxiliary snapshot event FIFO, must be a power of 2 */
+#define SNAPSHOT_QUEUE_SIZE 16
+#define SNAPSHOT_QUEUE_MASK (SNAPSHOT_QUEUE_SIZE - 1)
+
+/* On-target load generator (PTPD_LOADGEN), emulated slaves of instance 0 */
+#define LOADGEN_SLAVES            256 /* emulated slave ports */
+#define LOADGEN_LOG_INTERVAL      0 /* each slave sends a Delay_Req every 2^x seconds */
+#define LOADGEN_BURST             32 /* most Delay_Req injected by one loadgenService call */
+#define LOADGEN_LATENCY_BINS      16 /* bin n counts responses within [2^n, 2^(n+1)) usec */
+#define LOADGEN_REPORT_S          10 /* seconds between two reports */
+
+/* GNSS (PPS + NMEA) discipline */
+
+#define DEFAULT_GNSS              FALSE
+#define DEFAULT_GNSS_PPS_INPUT    0 /* auxiliary snapshot input wired to the receiver PPS */
+#define NMEA_LINE_LENGTH          83 /* 82 characters including $ and CR LF */
+#define GNSS_STEP_THRESHOLD_NS    1000000 /* step the clock above 1 ms */
+#define GNSS_LOCK_THRESHOLD_NS    1000 /* PPS offset < 1 us counts as a good sample */
+#define GNSS_LOCK_SAMPLES         4 /* consecutive good samples to declare lock */
+#define GNSS_LOCK_TIMEOUT_S       5 /* no good sample for 5 s -> holdover */
+#define GNSS_HOLDOVER_TIMEOUT_S   600 /* holdover for 10 min -> free running */
+#define GNSS_LOCKED_CLOCK_CLASS   6
+#define GNSS_HOLDOVER_CLOCK_CLASS 7
+#define GNSS_CLOCK_ACCURACY       0x21 /* within 100 ns */
+
+/* Number of PtpClock instances (ports or domains) run by ptpd_task. Instances
+ * sharing an interface need SO_REUSE and SO_REUSE_RXTOALL in lwipopts.h.
+ * With PTPD_BOUNDARY_CLOCK or PTPD_TRANSPARENT_CLOCK the instances are the
+ * ports of one clock, each one on its own interface. */
+#ifndef PTPD_NUMBER_INSTANCES
+#if defined(PTPD_BOUNDARY_CLOCK) || defined(PTPD_TRANSPARENT_CLOCK)
+#define PTPD_NUMBER_INSTANCES 2
+#else
+#define PTPD_NUMBER_INSTANCES 1
+#endif
+#endif
+
+/* End-to-end transparent clock */
+#define TC_RESIDENCE_RECORDS      16 /* events waiting for their follow-up or response */
+#define TC_MAX_RATE_RATIO_PPB     1000000 /* ignore rate ratios above 1000 ppm */
+#define TC_RATE_RATIO_S           2 /* exponential smoothing of the rate ratio - 2^s */
+#define TC_RATE_INTERVAL_MAX_NS   1000000000000LL /* Syncs further apart are not compared, 1000 s */
+
+/* Unicast message negotiation */
+#define DEFAULT_UNICAST_NEGOTIATION     FALSE
+#define DEFAULT_UNICAST_GRANT_DURATION  60 /* seconds asked by a slave */
+#define UNICAST_GRANT_DURATION_MAX      300 /* longest grant given by a master */
+#define UNICAST_MAX_GRANTS              16 /* grants kept by a master, one per slave and message type */
+#define UNICAST_REQUESTS                3 /* Announce, Sync and Delay_Resp asked by a slave */
+#define UNICAST_RETRY_S                 4 /* wait before asking again for a grant */
+#define UNICAST_CANCEL_RETRIES          3 /* a CANCEL not acknowledged is sent again every second */
+
+/* Hybrid delay mode, Delay_Req and Delay_Resp in unicast with multicast Sync and Announce */
+#define DEFAULT_HYBRID_DELAY            FALSE
+
+/* Messages handled by one doState call, bounds the delay of the timers behind a full queue */
+#define DEFAULT_RX_BUDGET               PBUF_QUEUE_SIZE
+
+/* Two-step Sync and Follow_Up pairing */
+#define SYNC_PAIR_ENTRIES               4 /* Sync or Follow_Up waiting for their other half */
+#define SYNC_PAIR_TIMEOUT_INTERVALS     4 /* a half waits at most this many sync intervals */
+
+/* Delay_Req waiting for their Delay_Resp, must be a power of 2 */
+#define DELAYREQ_INFLIGHT               8
+#define DELAYREQ_INFLIGHT_MASK          (DELAYREQ_INFLIGHT - 1)
+#define DELAYREQ_TIMEOUT_INTERVALS      4 /* a Delay_Req waits at most this many longest request intervals */
+
+/* Delay_Req burst of a slave entering UNCALIBRATED */
+#define DEFAULT_DELAYREQ_BURST          8 /* Delay_Req of the burst, 0 disables it */
+#define DELAYREQ_BURST_LOG_SPEEDUP      (DELAYRESP_RATE_SLACK - 1) /* spacing 2^-x of the interval, twice what a master allows: late ticks and jitter shorten it */
+#define DELAYREQ_BURST_STABLE_NS        1000 /* the burst ends when two delays differ by less */
+
+/* Hot standby, a slave measures the second best master along with its parent */
+#define DEFAULT_HOT_STANDBY             FALSE
+
+/* Ensemble, a slave steers to the weighted mean of the offsets from all the qualified masters */
+#define DEFAULT_ENSEMBLE                FALSE
+#define ENSEMBLE_MASTERS                3 /* masters measured besides the parent */
+#define ENSEMBLE_REJECT_NS              1000 /* a master further than this from the median is left out */
+#define ENSEMBLE_DEVIATION_MIN_NS       10 /* floor of the deviation, no master takes all the weight */
+#define ENSEMBLE_DEVIATION_MAX_NS       65535 /* ceiling of the deviation, the weight 2^32 / deviation^2 is then at least 1 */
+
+/* Message interval requests (802.1AS 10.6.4.3) */
+#define DEFAULT_INTERVAL_REQUESTS       FALSE
+#define DEFAULT_SYNC_INTERVAL_ACQUIRE   -3 /* Sync interval asked while UNCALIBRATED */
+#define DEFAULT_SYNC_INTERVAL_LOCKED    1 /* Sync interval asked once SLAVE */
+#define INTERVAL_NO_CHANGE              -128
+#define INTERVAL_INITIAL                126 /* back to the configured interval */
+#define INTERVAL_STOP                   127 /* taken as INTERVAL_INITIAL, multicast is not stopped */
+#define INTERVAL_LOG_MAX                6 /* slowest interval a master accepts */
+#define INTERVAL_REQUEST_ENTRIES        16 /* slave ports whose request a master keeps */
+#define INTERVAL_REFRESH_MS             30000 /* a slave repeats its request */
+#define INTERVAL_RETRY_MS               2000 /* a slave asks again when the Sync do not follow */
+#define INTERVAL_TIMEOUT_MS             (4 * INTERVAL_REFRESH_MS) /* a master forgets a request */
+
+/* Master Delay_Resp fast path */
+/* Slave ports whose Delay_Req rate is tracked, a multiple of the ways. It must
+ * cover the ports asking within 2^(logMinDelayReqInterval - slack), 64 for the
+ * 256 slaves of the load generator asking every second. */
+#ifndef DELAYRESP_RATE_ENTRIES
+#define DELAYRESP_RATE_ENTRIES          128
+#endif
+#define DELAYRESP_RATE_WAYS             4 /* entries a port hashes to, the least recently seen one is replaced */
+#define DELAYRESP_RATE_SETS             (DELAYRESP_RATE_ENTRIES / DELAYRESP_RATE_WAYS)
+#define DELAYRESP_RATE_SLACK            2 /* a slave may ask 2^slack times faster than logMinDelayReqInterval */
+
+/* Period of the ptpd_tick calls, the interval timers count in usec */
+#define PTPD_TIMER_TICK_MS 1
+#define PTPD_TIMER_TICK_US (PTPD_TIMER_TICK_MS * 1000)
+
+/* Foreign master table of an instance, hundreds of masters fit with PTPD_FOREIGN_RECORDS set by the build */
+#ifndef PTPD_FOREIGN_RECORDS
+#define PTPD_FOREIGN_RECORDS DEFAULT_MAX_FOREIGN_RECORDS
+#endif
+
+/* Hash chains of the foreign master table, must be a power of 2, about the number of records */
+#ifndef FOREIGN_HASH_BUCKETS
+#define FOREIGN_HASH_BUCKETS 8
+#endif
+#define FOREIGN_HASH_MASK (FOREIGN_HASH_BUCKETS - 1)
+
+/* Received messages waiting for the PTP task, lwipopts.h PBUF_POOL_SIZE must cover them */
 /* Must be a power of 2 */
-#define PBUF_QUEUE_SIZE 4
+#ifndef PBUF_QUEUE_SIZE
+#define PBUF_QUEUE_SIZE 8
+#endif
 #define PBUF_QUEUE_MASK (PBUF_QUEUE_SIZE - 1)
 
 /* others */
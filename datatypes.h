@@ -218,6 +218,19 @@ typedef struct
 		char* tlv;
 }MsgSignaling;
 
+/**
+* \brief Unicast negotiation TLV fields (Tables 73 to 76 of the spec)
+ */
+
+typedef struct
+{
+		enum16bit_t tlvType;
+		enum4bit_t messageType;
+		int8_t logInterMessagePeriod;
+		uint32_t durationField;
+		bool  renewalInvited;
+}MsgUnicastTLV;
+
 /**
 * \brief Management message fields (Table 37 of the spec)
  */
@@ -242,6 +255,247 @@ typedef struct
 		int32_t nanoseconds;
 } TimeInternal;
 
+/**
+* \brief Timestamp of an external event taken on the auxiliary snapshot inputs
+ */
+
+typedef struct
+{
+		TimeInternal time; /**< PTP time of the event */
+		uint8_t inputs; /**< auxiliary inputs which triggered the snapshot */
+} SnapshotEvent;
+
+/**
+* \brief Auxiliary snapshot counters
+ */
+
+typedef struct
+{
+		uint32_t events; /**< snapshots moved to the event FIFO or to a claimed input */
+		uint32_t missed; /**< triggers lost because the MAC FIFO was full */
+		uint32_t overflows; /**< snapshots dropped because the event FIFO was full */
+} SnapshotStats;
+
+/**
+* \brief Counters of the on-target load generator
+ */
+
+typedef struct
+{
+		uint32_t injected; /**< Delay_Req placed in the event queue */
+		uint32_t queueDrops; /**< Delay_Req refused by the full event queue */
+		uint32_t allocFails; /**< Delay_Req lost because the pbuf pool was empty */
+		uint32_t lagged; /**< Delay_Req not injected because the task fell behind */
+		uint32_t responses; /**< Delay_Resp sent to emulated slaves */
+		uint32_t latency[LOADGEN_LATENCY_BINS]; /**< Delay_Req receipt to Delay_Resp sent, log2 usec bins */
+		uint64_t busyNs; /**< time spent in doState during the last report period */
+		uint32_t messages; /**< Delay_Req handled during the last report period */
+} LoadGenStats;
+
+/**
+* \brief GNSS discipline state: NMEA time of day labels the PPS edges
+ */
+
+typedef struct
+{
+		octet_t line[NMEA_LINE_LENGTH]; /**< NMEA sentence being received */
+		int16_t lineLength;
+
+		bool  ppsValid; /**< PPS edge waiting for its NMEA time of day */
+		TimeInternal ppsTime; /**< MAC time of the last PPS edge */
+
+		bool  locked;
+		bool  holdover;
+		int16_t goodSamples;
+		TimeInternal lastSample; /**< MAC time of the last good sample */
+		TimeInternal offset; /**< last offset of the MAC clock from GNSS time */
+		int32_t  drift; /**< accumulator of the PI regulator */
+} GnssDiscipline;
+
+/**
+* \brief Residence time of an event message relayed by the transparent clock
+ */
+
+typedef struct
+{
+		bool  valid;
+		enum4bit_t messageType;
+		int16_t sequenceId;
+		PortIdentity identity; /**< sender of the event, requester of a response */
+		int16_t ingressPort, egressPort; /**< port numbers the event came in and left on */
+		TimeInternal ingress;
+		int64_t correction; /**< correctionField of the event */
+		int64_t residence; /**< scaled nanoseconds */
+} ResidenceRecord;
+
+/**
+* \brief End-to-end transparent clock state, shared by all the ports
+ */
+
+typedef struct
+{
+		ResidenceRecord records[TC_RESIDENCE_RECORDS];
+		int16_t i; /**< next record to replace */
+
+		bool  syncValid;
+		TimeInternal syncIngress, syncOrigin; /**< last Sync, for the rate ratio */
+		int32_t  rateRatioPpb; /**< master frequency offset from the local clock */
+
+		octet_t buf[PACKET_SIZE]; /**< message being relayed */
+} TransparentClock;
+
+/**
+* \brief Unicast transmission of a message type, given by a master or asked by a slave
+ */
+
+typedef struct
+{
+		bool  granted;
+		PortIdentity portIdentity; /**< slave the grant was given to */
+		ip_addr_t addr; /**< where the messages go */
+		enum4bit_t messageType;
+		int8_t  logInterval; /**< logInterMessagePeriod */
+		uint32_t duration; /**< seconds granted */
+		uint32_t left; /**< seconds before the grant expires */
+		int16_t  count; /**< port intervals before the next message, seconds before asking again */
+		int16_t  cancel; /**< CANCEL sent and not acknowledged, seconds it is sent again */
+} UnicastGrant;
+
+/**
+* \brief Message interval request TLV fields (802.1AS 10.6.4.3)
+ */
+
+typedef struct
+{
+		int8_t linkDelayInterval;
+		int8_t timeSyncInterval;
+		int8_t announceInterval;
+		uint8_t flags;
+} MsgIntervalTLV;
+
+/**
+* \brief Intervals asked by a slave port of a master
+ */
+
+typedef struct
+{
+		bool  active;
+		PortIdentity portIdentity;
+		int8_t syncInterval; /**< INTERVAL_NO_CHANGE when the slave has no wish */
+		int8_t announceInterval;
+		uint32_t received; /**< timerNow() of the last request */
+} IntervalRequest;
+
+/**
+* \brief Halves of a two-step Sync received so far, whichever arrived first
+ */
+
+typedef struct
+{
+		bool  sync; /**< the Sync was received */
+		bool  followUp; /**< the Follow_Up was received */
+		int16_t sequenceId;
+		uint32_t received; /**< timerNow() of the first half */
+		TimeInternal syncReceipt; /**< receive timestamp of the Sync */
+		TimeInternal preciseOriginTimestamp; /**< from the Follow_Up */
+		TimeInternal correctionField; /**< sum of the correction fields received */
+} SyncPair;
+
+/**
+* \brief Delay_Req sent by a slave, waiting for its Delay_Resp
+ */
+
+typedef struct
+{
+		bool  pending;
+		int16_t sequenceId;
+		uint32_t sent; /**< timerNow() of the transmission */
+		TimeInternal timestamp; /**< t3, transmit timestamp with the outbound latency */
+} DelayReqSent;
+
+/**
+* \brief A foreign master measured alongside the parent, the hot standby or one of the ensemble
+ */
+
+typedef struct
+{
+		bool  active; /**< a standby master is tracked */
+		PortIdentity portIdentity; /**< the tracked foreign master */
+		int16_t stepsRemoved; /**< of the local clock through this master */
+		int8_t  logSyncInterval; /**< Sync interval of the master */
+		uint32_t lastSync; /**< timerNow() of its last Sync */
+		SyncPair pair; /**< its two-step Sync waiting for the other half */
+		TimeInternal Tms; /**< master to slave time of its last Sync */
+		TimeInternal offsetFromMaster; /**< filtered offset of the local clock from the standby */
+		TimeInternal meanPathDelay; /**< filtered path delay to the standby */
+		int32_t deviation; /**< filtered deviation of the offsets from their mean */
+		Filter  ofm_filt; /**< same order as the one of the parent, handed over with it */
+		Filter  owd_filt;
+		Filter  dev_filt;
+} MasterTracker;
+
+/**
+* \brief Ensemble of the qualified foreign masters, combined into one offset
+ */
+
+typedef struct
+{
+		MasterTracker masters[ENSEMBLE_MASTERS]; /**< qualified foreign masters other than the parent */
+		int32_t parentDeviation; /**< filtered deviation of the offsets from the parent */
+		Filter  dev_filt;
+		uint8_t used; /**< masters in the last estimate, the parent included */
+		uint8_t rejected; /**< masters left out of the last estimate as diverging */
+} Ensemble;
+
+/**
+* \brief Delay_Req rate of a slave port, for the master rate limit
+ */
+
+typedef struct
+{
+		PortIdentity portIdentity;
+		TimeInternal last; /**< receipt of its last answered Delay_Req */
+} DelayReqRate;
+
+/**
+* \brief Counters of the master Delay_Resp fast path
+ */
+
+typedef struct
+{
+		uint32_t requests; /**< Delay_Req received */
+		uint32_t responses; /**< Delay_Resp sent */
+		uint32_t rateDrops; /**< Delay_Req above the rate allowed to their port */
+		uint32_t rateEvictions; /**< rate entries replaced within the minimum interval, too small a table */
+		uint32_t sendDrops; /**< Delay_Resp the network could not send */
+		uint32_t requestsPerSecond; /**< Delay_Req received during the last second */
+} DelayRespStats;
+
+/**
+* \brief Counters of the incremental Erbest tracking
+ */
+
+typedef struct
+{
+		uint32_t announces; /**< Announce added to the foreign records */
+		uint32_t decisions; /**< state decisions run */
+		uint32_t avoided; /**< Announce which changed neither Erbest nor the qualified records, no decision */
+		uint32_t searches; /**< Erbest searched again over all the records */
+} BmcStats;
+
+/**
+* \brief Master Delay_Resp fast path, answers are patched into a prepared message
+ */
+
+typedef struct
+{
+		octet_t buf[DELAY_RESP_LENGTH]; /**< Delay_Resp template */
+		DelayReqRate rates[DELAYRESP_RATE_ENTRIES]; /**< DELAYRESP_RATE_SETS sets of DELAYRESP_RATE_WAYS, by port hash */
+		int32_t second; /**< second being counted */
+		uint32_t secondRequests;
+		DelayRespStats stats;
+} DelayRespEngine;
+
 /**
 * \brief ForeignMasterRecord is used to manage foreign masters
  */
@@ -254,6 +508,11 @@ typedef struct
 		/* This one is not in the spec */
 		MsgAnnounce  announce;
 		MsgHeader    header;
+		uint32_t receipts[DEFAULT_FOREIGN_MASTER_THRESHOLD]; /**< timerNow() of the last Announce messages */
+		uint8_t  receipt; /**< newest of receipts */
+		int16_t  newer; /**< next record in the order of the last Announce, -1 for none */
+		int16_t  older;
+		int16_t  chain; /**< next record of the same hash bucket, -1 for none */
 
 } ForeignMasterRecord;
 
@@ -358,8 +617,12 @@ typedef struct
 		/* Other things we need for the protocol */
 		int16_t count;
 		int16_t  capacity;
-		int16_t  i;
-		int16_t  best;
+		int16_t  newest; /**< record of the last Announce, -1 when empty */
+		int16_t  oldest; /**< first record to expire */
+		int16_t  worst; /**< record replaced by a better new master when full, -1 to be searched */
+		int16_t  best; /**< Erbest, kept as records change, -1 to be searched */
+		bool   changed; /**< Erbest or a qualified record changed since the last decision */
+		int16_t  buckets[FOREIGN_HASH_BUCKETS]; /**< first record of each hash chain, -1 for none */
 } ForeignMasterDS;
 
 /**
@@ -397,6 +660,29 @@ typedef struct
 		TimeInternal  inboundLatency, outboundLatency;
 		int16_t   maxForeignRecords;
 		enum8bit_t  delayMechanism;
+		enum8bit_t  transport; /**< UDP_IPV4, UDP_IPV6 or IEE_802_3 */
+		uint8_t  ipv6Scope; /**< scope x of the FF0x::181 group */
+		bool   unicastNegotiation; /**< grant unicast messages, and ask unicastAddress for them */
+		uint32_t  unicastGrantDuration; /**< seconds of the grants asked by a slave */
+		bool   hybridDelay; /**< send Delay_Req to the source address of the parent */
+		uint8_t  delayReqBurst; /**< Delay_Req sent quickly when entering UNCALIBRATED */
+		bool   intervalRequests; /**< ask the master for the Sync interval, and honour the requests as a master */
+		bool   hotStandby; /**< measure the second best master too, and switch to it without calibrating again */
+		bool   ensemble; /**< measure every qualified master and steer to their weighted mean */
+		int8_t  syncIntervalAcquire; /**< Sync interval asked while UNCALIBRATED */
+		int8_t  syncIntervalLocked; /**< Sync interval asked once SLAVE */
+		uint16_t  rxBudget; /**< messages handled by one doState call, at least 1 */
+		int16_t   portNumber; /**< 1 for an ordinary clock */
+		uint32_t  ppsInterval; /**< flexible PPS period in nsec, 0 -> fixed frequency */
+		uint32_t  ppsWidth; /**< flexible PPS pulse width in nsec */
+		uint8_t  snapshotInputs; /**< auxiliary snapshot inputs to timestamp */
+		bool   currentUtcOffsetValid;
+		bool   timeTraceable;
+		bool   frequencyTraceable;
+		bool   ptpTimescale;
+		enum8bit_t  timeSource;
+		bool   gnss; /**< discipline the clock from PPS + NMEA */
+		uint8_t  gnssPpsInput; /**< auxiliary snapshot input of the PPS */
 	Servo servo;
 } RunTimeOpts;
 
@@ -406,7 +692,7 @@ typedef struct
  */
 /* main program data structure */
 
-typedef struct
+typedef struct PtpClock
 {
 
 	DefaultDS defaultDS; /**< default data set */
@@ -446,10 +732,8 @@ typedef struct
 	TimeInternal pdelay_t4; /**< peer delay time t4 */
 
 		TimeInternal timestamp_syncRecieve; /**< timestamp of Sync message */
-		TimeInternal timestamp_delayReqSend; /**< timestamp of delay request message */
 		TimeInternal timestamp_delayReqRecieve; /**< timestamp of delay request message */
 
-		TimeInternal correctionField_sync; /**< correction field of Sync and FollowUp messages */
 		TimeInternal correctionField_pDelayResp; /**< correction fieald of peedr delay response */
 
 		/* MsgHeader  PdelayReqHeader; */ /**< last recieved peer delay reques header */
@@ -460,9 +744,23 @@ typedef struct
 		int16_t sentAnnounceSequenceId;
 
 		int16_t recvPDelayReqSequenceId;
-		int16_t recvSyncSequenceId;
 
-		bool   waitingForFollowUp; /**< true if sync message was recieved and 2step flag is set */
+		SyncPair syncPairs[SYNC_PAIR_ENTRIES]; /**< two-step Sync waiting for their Follow_Up, or the reverse */
+		DelayReqSent delayReqs[DELAYREQ_INFLIGHT]; /**< Delay_Req in flight, indexed by sequenceId */
+		uint8_t  delayReqBurst; /**< Delay_Req left in the startup burst */
+		int32_t  burstDelay; /**< last mean path delay of the burst */
+		uint32_t uncalibratedSince; /**< timerNow() entering UNCALIBRATED */
+		uint32_t calibrationMs; /**< time from UNCALIBRATED to SLAVE, last time */
+		bool   holdover; /**< the parent stopped sending Sync and no other master is known */
+		bool   failingOver; /**< the parent went silent, waiting for the Sync of the next one */
+		uint32_t lastParentSync; /**< timerNow() of the last Sync of the parent */
+		uint32_t failoverMs; /**< time from the last Sync of the silent parent to the first of the next one, last time */
+		MasterTracker standby; /**< second best master of a hot standby slave */
+		Ensemble ensemble; /**< the other masters of an ensemble slave */
+
+		IntervalRequest intervalRequests[INTERVAL_REQUEST_ENTRIES]; /**< intervals asked by the slaves of a master */
+		int8_t  intervalWanted; /**< Sync interval a slave asks for */
+		uint32_t intervalSent; /**< timerNow() of the last request of a slave */
 	bool   waitingForPDelayRespFollowUp; /**< true if PDelayResp message was recieved and 2step flag is set */
 
 		Filter  ofm_filt; /**< filter offset from master */
@@ -485,10 +783,30 @@ typedef struct
 
 		int32_t  events;
 
+		GnssDiscipline gnss;
+
+		IntervalTimer itimer[TIMER_ARRAY_SIZE];
+
 		enum8bit_t  stats;
 
 		RunTimeOpts * rtOpts;
 
+		struct PtpClock * ports; /**< all the ports of a boundary or transparent clock, port 1 first */
+
+		TransparentClock * tc; /**< residence time records of a transparent clock */
+
+		UnicastGrant unicastGrants[UNICAST_MAX_GRANTS]; /**< grants given by a master */
+		UnicastGrant unicastRequests[UNICAST_REQUESTS]; /**< grants asked by a slave */
+		bool  unicastRequesting; /**< unicastAddress holds the master to ask */
+		int16_t sentSignalingSequenceId;
+
+		DelayRespEngine delayResp; /**< master Delay_Resp fast path */
+		BmcStats bmcStats; /**< state decisions run and avoided */
+
+		ip_addr_t parentAddr; /**< source address of the last Sync or Announce of the parent */
+		PortIdentity parentAddrIdentity; /**< port which sent from parentAddr */
+		bool  parentAddrKnown;
+
 } PtpClock;
 
 #endif /* DATATYPES_H_*/
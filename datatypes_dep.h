@@ -51,23 +51,50 @@ typedef struct
 typedef struct
 {
 	void      *pbuf[PBUF_QUEUE_SIZE];
+	ip_addr_t addr[PBUF_QUEUE_SIZE]; /**< source address of each buffer */
 	int16_t   head;
 	int16_t   tail;
+	uint32_t  drops; /**< buffers refused because the queue was full */
 	//sys_mutex_t mutex;
 } BufQueue;
 
+// Received messages dropped before the queues, by reason
+typedef struct
+{
+	uint32_t  length; /**< shorter than the header or their messageLength, or too long */
+	uint32_t  version; /**< not versionPTP 2 */
+	uint32_t  domain; /**< of another domain */
+	uint32_t  type; /**< reserved message type */
+	uint32_t  self; /**< sent by this port */
+} NetDrops;
+
+// Periodic timer, decremented from the system tick
+typedef struct
+{
+	volatile uint32_t left; /**< usec */
+	volatile uint32_t interval; /**< usec, read by timerUpdate from the system tick */
+	volatile bool expired;
+} IntervalTimer;
+
 // Struct used  to store network datas
 typedef struct
 {
-	int32_t   multicastAddr;
-	int32_t   peerMulticastAddr;
-	int32_t   unicastAddr;
+	ip_addr_t   multicastAddr;
+	ip_addr_t   peerMulticastAddr;
+	ip_addr_t   unicastAddr;
+	ip_addr_t   lastRecvAddr; /**< source address of the last received message */
+
+	struct netif    *netif; /**< interface of this instance */
+	enum8bit_t    transport; /**< UDP_IPV4, UDP_IPV6 or IEE_802_3 */
 
 	struct udp_pcb    *eventPcb;
 	struct udp_pcb    *generalPcb;
 
 	BufQueue    eventQ;
 	BufQueue    generalQ;
+
+	struct PtpClock *ptpClock; /**< owner, whose data sets the classifier checks */
+	NetDrops    drops;
 } NetPath;
 
 // Define compiler specific symbols
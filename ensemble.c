@@ -0,0 +1,147 @@
+/* ensemble.c */
+
+#include "ptpd.h"
+
+/* Ensemble time. The BMC still selects the parent, which gives the time
+ * properties and the announced data sets, but the slave measures every
+ * qualified foreign master with the trackers of standby.c and steers to the
+ * weighted mean of their offsets. A master weighs 1 / (deviation^2 *
+ * stepsRemoved), the deviation being the filtered distance of its offsets from
+ * their mean. A master further than ENSEMBLE_REJECT_NS from the median of all
+ * is left out, so one master going wrong does not pull the clock. */
+
+static uint64_t ensembleWeight(int32_t deviation, int16_t stepsRemoved)
+{
+	uint64_t d = max(min(deviation, ENSEMBLE_DEVIATION_MAX_NS), ENSEMBLE_DEVIATION_MIN_NS);
+	uint64_t weight = ((uint64_t) 1 << 32) / (d * d * max(stepsRemoved, 1));
+
+	/* A master counted in the mean weighs at least 1, whatever its steps; a
+	 * larger numerator would overflow the weighted sum of the offsets */
+	return max(weight, 1);
+}
+
+static int32_t ensembleMedian(const int32_t *offsets, int16_t n)
+{
+	int32_t sorted[ENSEMBLE_MASTERS + 1];
+	int32_t offset;
+	int16_t i, j;
+
+	for (i = 0; i < n; i++)
+	{
+		offset = offsets[i];
+		for (j = i; j > 0 && sorted[j - 1] > offset; j--) sorted[j] = sorted[j - 1];
+		sorted[j] = offset;
+	}
+
+	if (n & 1) return sorted[n / 2];
+
+	return (int32_t)(((int64_t) sorted[n / 2 - 1] + sorted[n / 2]) / 2);
+}
+
+void ensembleReset(PtpClock *ptpClock)
+{
+	memset(&ptpClock->ensemble, 0, sizeof(Ensemble));
+	ptpClock->ensemble.dev_filt.s = ptpClock->servo.sOffset;
+}
+
+void ensembleSelect(PtpClock *ptpClock)
+{
+	Ensemble *ensemble = &ptpClock->ensemble;
+	ForeignMasterRecord *records = ptpClock->foreignMasterDS.records;
+	MasterTracker *tracker;
+	int16_t i, j;
+
+	/* Forget the parent and the masters no longer qualified, follow the stepsRemoved of the others */
+	for (j = 0; j < ENSEMBLE_MASTERS; j++)
+	{
+		tracker = &ensemble->masters[j];
+		if (!tracker->active) continue;
+
+		for (i = 0; i < ptpClock->foreignMasterDS.count; i++)
+		{
+			if (isSamePortIdentity(&records[i].foreignMasterPortIdentity, &tracker->portIdentity)) break;
+		}
+
+		if (i == ptpClock->foreignMasterDS.count || !isQualifiedForeign(ptpClock, &records[i]) ||
+				isSamePortIdentity(&tracker->portIdentity, &ptpClock->parentDS.parentPortIdentity))
+		{
+			DBGV("ensembleSelect: master %d left\n", j);
+			tracker->active = FALSE;
+			continue;
+		}
+
+		tracker->stepsRemoved = records[i].announce.stepsRemoved + 1;
+	}
+
+	/* Measure the qualified masters not tracked yet, while a tracker is free */
+	for (i = 0, j = 0; i < ptpClock->foreignMasterDS.count; i++)
+	{
+		if (!isQualifiedForeign(ptpClock, &records[i]) ||
+				isSamePortIdentity(&records[i].foreignMasterPortIdentity, &ptpClock->parentDS.parentPortIdentity) ||
+				standbyFind(ptpClock, &records[i].foreignMasterPortIdentity) != NULL)
+		{
+			continue;
+		}
+
+		while (j < ENSEMBLE_MASTERS && ensemble->masters[j].active) j++;
+		if (j == ENSEMBLE_MASTERS) break;
+
+		standbyTrack(ptpClock, &ensemble->masters[j], &records[i]);
+		DBG("ensembleSelect: tracking record %d\n", i);
+	}
+}
+
+void ensembleCombine(PtpClock *ptpClock)
+{
+	Ensemble *ensemble = &ptpClock->ensemble;
+	MasterTracker *tracker;
+	int32_t offsets[ENSEMBLE_MASTERS + 1];
+	uint64_t weights[ENSEMBLE_MASTERS + 1];
+	int32_t median;
+	int64_t sum = 0;
+	uint64_t total = 0;
+	int16_t i, n;
+
+	offsets[0] = ptpClock->currentDS.offsetFromMaster.nanoseconds;
+	weights[0] = ensembleWeight(ensemble->parentDeviation, ptpClock->currentDS.stepsRemoved);
+	n = 1;
+
+	for (i = 0; i < ENSEMBLE_MASTERS; i++)
+	{
+		tracker = &ensemble->masters[i];
+		if (!tracker->active || !standbyFresh(ptpClock, tracker) || tracker->offsetFromMaster.seconds != 0) continue;
+
+		offsets[n] = tracker->offsetFromMaster.nanoseconds;
+		weights[n] = ensembleWeight(tracker->deviation, tracker->stepsRemoved);
+		n++;
+	}
+
+	ensemble->used = 0;
+	ensemble->rejected = 0;
+	median = ensembleMedian(offsets, n);
+
+	for (i = 0; i < n; i++)
+	{
+		if (abs(offsets[i] - median) > ENSEMBLE_REJECT_NS)
+		{
+			DBGV("ensembleCombine: master %d off by %d nsec\n", i, offsets[i] - median);
+			ensemble->rejected++;
+			continue;
+		}
+
+		sum += (int64_t) weights[i] * offsets[i];
+		total += weights[i];
+		ensemble->used++;
+	}
+
+	/* Two masters which disagree, keep the parent */
+	if (total == 0)
+	{
+		ensemble->used = 1;
+		return;
+	}
+
+	ptpClock->currentDS.offsetFromMaster.nanoseconds = (int32_t)(sum / (int64_t) total);
+	DBGV("ensembleCombine: %d masters, %d left out, offset %d nsec\n", ensemble->used, ensemble->rejected,
+			ptpClock->currentDS.offsetFromMaster.nanoseconds);
+}
@@ -0,0 +1,303 @@
+/* gnss.c */
+
+#include "../ptpd.h"
+
+/* The receiver marks the start of each UTC second with a PPS edge, which is
+ * timestamped by the MAC on an auxiliary snapshot input, and then reports the
+ * time of day of that second in an NMEA sentence (RMC or ZDA). The pair gives
+ * one offset sample per second for a step or the PI regulator. */
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static int32_t daysFromCivil(int32_t year, int32_t month, int32_t day)
+{
+	int32_t era, yoe, doy, doe;
+
+	year -= month <= 2;
+	era = year / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+static int32_t parseDigits(const octet_t *s, int16_t n)
+{
+	int32_t value = 0;
+
+	while (n-- > 0)
+	{
+		if (*s < '0' || *s > '9') return -1;
+		value = value * 10 + (*s++ - '0');
+	}
+
+	return value;
+}
+
+static int16_t hexDigit(octet_t c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+/* Verify the checksum and split the sentence in place, returns the number of fields */
+static int16_t splitSentence(octet_t *line, int16_t length, octet_t *fields[], int16_t maxFields)
+{
+	int16_t i, count;
+	uint8_t sum = 0;
+
+	if (length < 4 || line[0] != '$' || line[length - 3] != '*') return 0;
+	if (hexDigit(line[length - 2]) < 0 || hexDigit(line[length - 1]) < 0) return 0;
+
+	for (i = 1; i < length - 3; i++) sum ^= line[i];
+	if (sum != (hexDigit(line[length - 2]) << 4 | hexDigit(line[length - 1]))) return 0;
+
+	line[length - 3] = '\0';
+	fields[0] = line + 1;
+	count = 1;
+
+	for (i = 1; i < length - 3 && count < maxFields; i++)
+	{
+		if (line[i] == ',')
+		{
+			line[i] = '\0';
+			fields[count++] = line + i + 1;
+		}
+	}
+
+	return count;
+}
+
+/* hhmmss[.ss] and ddmmyy into UTC seconds, returns FALSE on malformed fields */
+static bool  utcSeconds(const octet_t *hms, int32_t day, int32_t month, int32_t year, int32_t *seconds)
+{
+	int32_t hour, minute, second;
+
+	hour = parseDigits(hms, 2);
+	minute = parseDigits(hms + 2, 2);
+	second = parseDigits(hms + 4, 2);
+
+	if (hour < 0 || minute < 0 || second < 0 || day < 1 || month < 1 || month > 12 || year < 1970)
+		return FALSE;
+
+	*seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+
+	return TRUE;
+}
+
+static void gnssSample(PtpClock *ptpClock, int32_t utc);
+
+static void gnssSentence(PtpClock *ptpClock, octet_t *line, int16_t length)
+{
+	octet_t *fields[12];
+	int16_t count;
+	int32_t utc;
+
+	count = splitSentence(line, length, fields, 12);
+	if (count < 1 || strlen((const char *) fields[0]) != 5) return;
+
+	if (!strcmp((const char *) fields[0] + 2, "RMC"))
+	{
+		/* $--RMC,hhmmss.ss,A,llll.ll,a,yyyyy.yy,a,x.x,x.x,ddmmyy,... */
+		if (count < 10 || fields[2][0] != 'A' || strlen((const char *) fields[1]) < 6 || strlen((const char *) fields[9]) != 6) return;
+
+		if (!utcSeconds(fields[1], parseDigits(fields[9], 2), parseDigits(fields[9] + 2, 2), 2000 + parseDigits(fields[9] + 4, 2), &utc))
+			return;
+	}
+	else if (!strcmp((const char *) fields[0] + 2, "ZDA"))
+	{
+		/* $--ZDA,hhmmss.ss,dd,mm,yyyy,zz,zz */
+		if (count < 5 || strlen((const char *) fields[1]) < 6 || strlen((const char *) fields[4]) != 4) return;
+
+		if (!utcSeconds(fields[1], parseDigits(fields[2], 2), parseDigits(fields[3], 2), parseDigits(fields[4], 4), &utc))
+			return;
+	}
+	else
+	{
+		return;
+	}
+
+	gnssSample(ptpClock, utc);
+}
+
+/* Advertise the quality of the time source, re-running the BMC if it changed */
+static void gnssSetQuality(PtpClock *ptpClock, uint8_t clockClass, enum8bit_t clockAccuracy, enum8bit_t timeSource, bool  traceable)
+{
+	RunTimeOpts *rtOpts = ptpClock->rtOpts;
+
+	if (ptpClock->defaultDS.clockQuality.clockClass == clockClass && rtOpts->timeTraceable == traceable) return;
+
+	DBG("gnssSetQuality: clock class %d\n", clockClass);
+
+	ptpClock->defaultDS.clockQuality.clockClass = clockClass;
+	ptpClock->defaultDS.clockQuality.clockAccuracy = clockAccuracy;
+	rtOpts->timeSource = timeSource;
+	rtOpts->timeTraceable = traceable;
+	rtOpts->frequencyTraceable = traceable;
+	rtOpts->currentUtcOffsetValid = traceable;
+
+	if (ptpClock->portDS.portState == PTP_MASTER || ptpClock->portDS.portState == PTP_PASSIVE)
+	{
+		m1(ptpClock);
+	}
+
+	if (ptpClock->foreignMasterDS.count > 0)
+	{
+		setFlag(ptpClock->events, STATE_DECISION_EVENT);
+	}
+}
+
+/* Apply the offset between the PPS timestamp and the UTC second it marks */
+static void gnssSample(PtpClock *ptpClock, int32_t utc)
+{
+	GnssDiscipline *gnss = &ptpClock->gnss;
+	TimeInternal target, now;
+	int32_t adj;
+
+	if (!gnss->ppsValid) return;
+	gnss->ppsValid = FALSE;
+
+	/* The sentence must follow its PPS edge within one second */
+	getTime(&now);
+	subTime(&now, &now, &gnss->ppsTime);
+	if (now.seconds != 0 || now.nanoseconds < 0)
+	{
+		DBGV("gnssSample: stale PPS\n");
+		return;
+	}
+
+	/* The clock keeps the PTP timescale (TAI) */
+	target.seconds = utc + ptpClock->rtOpts->currentUtcOffset;
+	target.nanoseconds = 0;
+	subTime(&gnss->offset, &gnss->ppsTime, &target);
+
+	DBGV("gnssSample: offset %d sec %d nsec\n", gnss->offset.seconds, gnss->offset.nanoseconds);
+
+	/* A slave port follows its master, GNSS only drives a grandmaster */
+	if (ptpClock->portDS.portState == PTP_SLAVE || ptpClock->portDS.portState == PTP_UNCALIBRATED) return;
+	if (ptpClock->servo.noAdjust) return;
+
+	if (gnss->offset.seconds != 0 || abs(gnss->offset.nanoseconds) > GNSS_STEP_THRESHOLD_NS)
+	{
+		getTime(&now);
+		subTime(&now, &now, &gnss->offset);
+		setTime(&now);
+		gnss->drift = 0;
+		gnss->goodSamples = 0;
+		adjFreq(0);
+		return;
+	}
+
+	/* The PI regulator, one sample per second */
+	gnss->drift += gnss->offset.nanoseconds / ptpClock->servo.ai;
+
+	if (gnss->drift > ADJ_FREQ_MAX)
+		gnss->drift = ADJ_FREQ_MAX;
+	else if (gnss->drift < -ADJ_FREQ_MAX)
+		gnss->drift = -ADJ_FREQ_MAX;
+
+	adj = gnss->offset.nanoseconds / ptpClock->servo.ap + gnss->drift;
+	adjFreq(-adj);
+
+	if (abs(gnss->offset.nanoseconds) < GNSS_LOCK_THRESHOLD_NS)
+	{
+		gnss->lastSample = gnss->ppsTime;
+
+		if (gnss->goodSamples < GNSS_LOCK_SAMPLES) gnss->goodSamples++;
+
+		if (gnss->goodSamples == GNSS_LOCK_SAMPLES && !gnss->locked)
+		{
+			DBG("gnssSample: locked\n");
+			gnss->locked = TRUE;
+			gnss->holdover = FALSE;
+			gnssSetQuality(ptpClock, GNSS_LOCKED_CLOCK_CLASS, GNSS_CLOCK_ACCURACY, GPS, TRUE);
+		}
+	}
+	else
+	{
+		gnss->goodSamples = 0;
+	}
+}
+
+void gnssInit(PtpClock *ptpClock)
+{
+	DBG("gnssInit: PPS on input %d\n", ptpClock->rtOpts->gnssPpsInput);
+
+	memset(&ptpClock->gnss, 0, sizeof(GnssDiscipline));
+
+	/* The PPS bypasses the event FIFO, which stays for the application */
+	snapshotClaim(ptpClock->rtOpts->gnssPpsInput);
+}
+
+/* Feed received NMEA characters, must be called from the PTP task context */
+void gnssInput(PtpClock *ptpClock, const octet_t *data, int16_t length)
+{
+	GnssDiscipline *gnss = &ptpClock->gnss;
+
+	while (length-- > 0)
+	{
+		octet_t c = *data++;
+
+		if (c == '$')
+		{
+			gnss->lineLength = 0;
+		}
+		else if (c == '\r' || c == '\n')
+		{
+			if (gnss->lineLength > 0) gnssSentence(ptpClock, gnss->line, gnss->lineLength);
+			gnss->lineLength = 0;
+			continue;
+		}
+		else if (gnss->lineLength == 0)
+		{
+			/* Wait for the start of the next sentence */
+			continue;
+		}
+
+		if (gnss->lineLength >= NMEA_LINE_LENGTH - 1)
+		{
+			/* Too long, drop the sentence */
+			gnss->lineLength = 0;
+			continue;
+		}
+
+		gnss->line[gnss->lineLength++] = c;
+	}
+}
+
+/* Collect the PPS timestamps and track the loss of the GNSS signal */
+void gnssService(PtpClock *ptpClock)
+{
+	GnssDiscipline *gnss = &ptpClock->gnss;
+	SnapshotEvent event;
+	TimeInternal now;
+
+	if (snapshotTake(ptpClock->rtOpts->gnssPpsInput, &event))
+	{
+		gnss->ppsTime = event.time;
+		gnss->ppsValid = TRUE;
+	}
+
+	if (!gnss->locked && !gnss->holdover) return;
+
+	getTime(&now);
+	subTime(&now, &now, &gnss->lastSample);
+
+	if (gnss->locked && now.seconds >= GNSS_LOCK_TIMEOUT_S)
+	{
+		DBG("gnssService: holdover\n");
+		gnss->locked = FALSE;
+		gnss->holdover = TRUE;
+		gnss->goodSamples = 0;
+		gnssSetQuality(ptpClock, GNSS_HOLDOVER_CLOCK_CLASS, GNSS_CLOCK_ACCURACY, GPS, TRUE);
+	}
+	else if (gnss->holdover && now.seconds >= GNSS_HOLDOVER_TIMEOUT_S)
+	{
+		DBG("gnssService: free running\n");
+		gnss->holdover = FALSE;
+		gnssSetQuality(ptpClock, ptpClock->rtOpts->clockQuality.clockClass,
+				ptpClock->rtOpts->clockQuality.clockAccuracy, DEFAULT_TIME_SOURCE, FALSE);
+	}
+}
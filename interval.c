@@ -0,0 +1,173 @@
+/* interval.c */
+
+#include "ptpd.h"
+
+/* Message interval requests, the ORGANIZATION_EXTENSION TLV of 802.1AS
+ * 10.6.4.3 in a Signaling message. A slave asks its parent for a short Sync
+ * interval while UNCALIBRATED and a longer one once SLAVE, and repeats the
+ * request every INTERVAL_REFRESH_MS. A master keeps the request of each slave
+ * port and sends its multicast Sync and Announce at the shortest interval asked,
+ * or at the configured one when no slave asks. */
+
+void intervalReset(PtpClock *ptpClock)
+{
+	memset(ptpClock->intervalRequests, 0, sizeof(ptpClock->intervalRequests));
+	ptpClock->portDS.logSyncInterval = ptpClock->rtOpts->syncInterval;
+	ptpClock->portDS.logAnnounceInterval = ptpClock->rtOpts->announceInterval;
+}
+
+void intervalRequest(PtpClock *ptpClock, int8_t syncInterval)
+{
+	MsgIntervalTLV tlv;
+
+	ptpClock->intervalWanted = syncInterval;
+	ptpClock->intervalSent = timerNow();
+
+	tlv.linkDelayInterval = INTERVAL_NO_CHANGE;
+	tlv.timeSyncInterval = syncInterval;
+	tlv.announceInterval = INTERVAL_NO_CHANGE;
+	tlv.flags = 0;
+
+	msgPackSignaling(ptpClock, ptpClock->msgObuf, &ptpClock->parentDS.parentPortIdentity);
+	msgPackIntervalTLV(ptpClock->msgObuf, &tlv);
+	msgPackUnicastFlag(ptpClock->msgObuf, FALSE);
+
+	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, flip16(*(int16_t*)(ptpClock->msgObuf + 2)), unicastMaster(ptpClock)))
+	{
+		ERROR("intervalRequest: can't sent\n");
+	}
+	else
+	{
+		DBG("intervalRequest: Sync every 2^%d s\n", syncInterval);
+		ptpClock->sentSignalingSequenceId++;
+	}
+}
+
+void intervalSync(PtpClock *ptpClock)
+{
+	int8_t logInterval = ptpClock->msgTmpHeader.logMessageInterval;
+	uint32_t elapsed = timerNow() - ptpClock->intervalSent;
+
+	if (!ptpClock->rtOpts->intervalRequests) return;
+
+	/* The servo normalizes the offset to the interval the master runs at */
+	if (logInterval >= LOG_INTERVAL_MIN && logInterval <= INTERVAL_LOG_MAX)
+		ptpClock->portDS.logSyncInterval = logInterval;
+
+	if (elapsed > INTERVAL_REFRESH_MS || (logInterval != ptpClock->intervalWanted && elapsed > INTERVAL_RETRY_MS))
+	{
+		intervalRequest(ptpClock, ptpClock->intervalWanted);
+	}
+}
+
+/* The requested interval, INTERVAL_NO_CHANGE for none */
+static int8_t intervalAsked(int8_t requested, int8_t previous)
+{
+	if (requested == INTERVAL_NO_CHANGE) return previous;
+	if (requested == INTERVAL_INITIAL || requested == INTERVAL_STOP) return INTERVAL_NO_CHANGE;
+
+	return max(min(requested, INTERVAL_LOG_MAX), LOG_INTERVAL_MIN);
+}
+
+/* Run the master timers at the shortest interval asked by a slave */
+static void intervalApply(PtpClock *ptpClock)
+{
+	int8_t syncInterval = INTERVAL_NO_CHANGE;
+	int8_t announceInterval = INTERVAL_NO_CHANGE;
+	int16_t i;
+
+	for (i = 0; i < INTERVAL_REQUEST_ENTRIES; i++)
+	{
+		IntervalRequest *request = &ptpClock->intervalRequests[i];
+
+		if (!request->active) continue;
+
+		if (request->syncInterval != INTERVAL_NO_CHANGE && (syncInterval == INTERVAL_NO_CHANGE || request->syncInterval < syncInterval))
+			syncInterval = request->syncInterval;
+
+		if (request->announceInterval != INTERVAL_NO_CHANGE && (announceInterval == INTERVAL_NO_CHANGE || request->announceInterval < announceInterval))
+			announceInterval = request->announceInterval;
+	}
+
+	if (syncInterval == INTERVAL_NO_CHANGE) syncInterval = ptpClock->rtOpts->syncInterval;
+	if (announceInterval == INTERVAL_NO_CHANGE) announceInterval = ptpClock->rtOpts->announceInterval;
+
+	if (syncInterval != ptpClock->portDS.logSyncInterval)
+	{
+		DBG("intervalApply: Sync every 2^%d s\n", syncInterval);
+		ptpClock->portDS.logSyncInterval = syncInterval;
+		timerStart(SYNC_INTERVAL_TIMER, pow2us(syncInterval), ptpClock->itimer);
+	}
+
+	if (announceInterval != ptpClock->portDS.logAnnounceInterval)
+	{
+		DBG("intervalApply: Announce every 2^%d s\n", announceInterval);
+		ptpClock->portDS.logAnnounceInterval = announceInterval;
+		timerStart(ANNOUNCE_INTERVAL_TIMER, pow2us(announceInterval), ptpClock->itimer);
+	}
+}
+
+void intervalSignaling(PtpClock *ptpClock, const MsgIntervalTLV *tlv)
+{
+	const PortIdentity *slave = &ptpClock->msgTmpHeader.sourcePortIdentity;
+	IntervalRequest *request = NULL;
+	IntervalRequest *oldest = NULL;
+	int16_t i;
+
+	if (!ptpClock->rtOpts->intervalRequests || ptpClock->portDS.portState != PTP_MASTER) return;
+
+	for (i = 0; i < INTERVAL_REQUEST_ENTRIES; i++)
+	{
+		IntervalRequest *entry = &ptpClock->intervalRequests[i];
+
+		if (entry->active && isSamePortIdentity(&entry->portIdentity, slave))
+		{
+			request = entry;
+			break;
+		}
+
+		if (oldest == NULL || (oldest->active && (!entry->active || entry->received - oldest->received > 0x80000000)))
+			oldest = entry;
+	}
+
+	if (request == NULL)
+	{
+		/* A new slave replaces a free or the oldest entry */
+		request = oldest;
+		request->active = TRUE;
+		request->portIdentity = *slave;
+		request->syncInterval = INTERVAL_NO_CHANGE;
+		request->announceInterval = INTERVAL_NO_CHANGE;
+	}
+
+	request->syncInterval = intervalAsked(tlv->timeSyncInterval, request->syncInterval);
+	request->announceInterval = intervalAsked(tlv->announceInterval, request->announceInterval);
+	request->received = timerNow();
+
+	DBGV("intervalSignaling: port %d asks Sync 2^%d Announce 2^%d\n", slave->portNumber, request->syncInterval, request->announceInterval);
+
+	intervalApply(ptpClock);
+}
+
+void intervalService(PtpClock *ptpClock)
+{
+	uint32_t now = timerNow();
+	bool  expired = FALSE;
+	int16_t i;
+
+	if (!ptpClock->rtOpts->intervalRequests) return;
+
+	for (i = 0; i < INTERVAL_REQUEST_ENTRIES; i++)
+	{
+		IntervalRequest *request = &ptpClock->intervalRequests[i];
+
+		if (request->active && now - request->received > INTERVAL_TIMEOUT_MS)
+		{
+			DBGV("intervalService: port %d stopped asking\n", request->portIdentity.portNumber);
+			request->active = FALSE;
+			expired = TRUE;
+		}
+	}
+
+	if (expired) intervalApply(ptpClock);
+}
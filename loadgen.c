@@ -0,0 +1,230 @@
+/* loadgen.c */
+
+#include "../ptpd.h"
+
+#ifdef PTPD_LOADGEN
+
+/* Emulated slaves send Delay_Req to an instance in master state through its
+ * event queue, so the master answers them through its usual path and sends the
+ * Delay_Resp on the network. The report gives the Delay_Req rate the board
+ * sustains, where the requests are lost and the response latency. */
+
+static PtpClock *loadgenClock;
+static uint16_t loadgenSlaves;
+static uint32_t loadgenIntervalUs; /* between two Delay_Req of a slave */
+static uint64_t loadgenCredit; /* slave-usec earned since the last injection */
+static uint16_t loadgenNext; /* next slave to send */
+static uint16_t loadgenSequenceId;
+static TimeInternal loadgenLast; /* last loadgenService call */
+static int32_t loadgenReportSecond;
+static uint32_t loadgenReportRequests; /* delayResp.stats.requests at the last report */
+static uint64_t loadgenBusyNs;
+static LoadGenStats loadgenStats;
+
+/* Emulated slaves have the clock identity 4C47FFFE0000xxxx */
+static void loadgenIdentity(octet_t *clockIdentity, uint16_t slave)
+{
+	clockIdentity[0] = 'L';
+	clockIdentity[1] = 'G';
+	clockIdentity[2] = 0xFF;
+	clockIdentity[3] = 0xFE;
+	clockIdentity[4] = 0;
+	clockIdentity[5] = 0;
+	clockIdentity[6] = slave >> 8;
+	clockIdentity[7] = slave & 0xFF;
+}
+
+static bool loadgenIsSlave(const PortIdentity *portIdentity)
+{
+	octet_t clockIdentity[CLOCK_IDENTITY_LENGTH];
+
+	loadgenIdentity(clockIdentity, 0);
+	return !memcmp(portIdentity->clockIdentity, clockIdentity, CLOCK_IDENTITY_LENGTH - 2);
+}
+
+/* Emulate slaves sending a Delay_Req every 2^logInterval seconds to ptpClock */
+void loadgenInit(PtpClock *ptpClock, uint16_t slaves, int8_t logInterval)
+{
+	DBG("loadgenInit: %d slaves, log interval %d\n", slaves, logInterval);
+
+	loadgenClock = ptpClock;
+	loadgenSlaves = slaves;
+	loadgenIntervalUs = (logInterval >= 0) ? 1000000 << logInterval : 1000000 >> -logInterval;
+	loadgenCredit = 0;
+	loadgenNext = 0;
+	loadgenSequenceId = 0;
+	getTime(&loadgenLast);
+	loadgenReportSecond = loadgenLast.seconds;
+	loadgenReportRequests = ptpClock->delayResp.stats.requests;
+	loadgenBusyNs = 0;
+	memset(&loadgenStats, 0, sizeof(loadgenStats));
+}
+
+/* Place the Delay_Req of the next slave in the event queue */
+static void loadgenInject(PtpClock *ptpClock, const TimeInternal *now)
+{
+	octet_t buf[DELAY_REQ_LENGTH];
+	Timestamp originTimestamp;
+	struct pbuf *p;
+
+	fromInternalTime(now, &originTimestamp);
+	msgPackHeader(ptpClock, buf);
+	msgPackDelayReq(ptpClock, buf, &originTimestamp);
+
+	/* sourcePortIdentity and sequenceId of the slave */
+	loadgenIdentity(buf + 20, loadgenNext);
+	*(int16_t*)(buf + 28) = flip16(1);
+	*(int16_t*)(buf + 30) = flip16(loadgenSequenceId);
+
+	if (++loadgenNext == loadgenSlaves)
+	{
+		loadgenNext = 0;
+		loadgenSequenceId++;
+	}
+
+	p = pbuf_alloc(PBUF_RAW, DELAY_REQ_LENGTH, PBUF_POOL);
+	if (p == NULL)
+	{
+		loadgenStats.allocFails++;
+		return;
+	}
+
+	pbuf_take(p, buf, DELAY_REQ_LENGTH);
+#if LWIP_PTP
+	p->time_sec = now->seconds;
+	p->time_nsec = now->nanoseconds;
+#endif
+
+	if (!netInjectEvent(&ptpClock->netPath, p))
+	{
+		loadgenStats.queueDrops++;
+		return;
+	}
+
+	loadgenStats.injected++;
+}
+
+/* Upper bound in usec of the latency bin reaching perMille of the responses */
+static uint32_t loadgenPercentile(uint32_t perMille)
+{
+	uint32_t target = (uint64_t) loadgenStats.responses * perMille / 1000;
+	uint32_t count = 0;
+	int16_t i;
+
+	for (i = 0; i < LOADGEN_LATENCY_BINS; i++)
+	{
+		count += loadgenStats.latency[i];
+		if (count > target) break;
+	}
+
+	return 2u << min(i, LOADGEN_LATENCY_BINS - 1);
+}
+
+static void loadgenReport(const PtpClock *ptpClock, int32_t seconds)
+{
+	const DelayRespStats *resp = &ptpClock->delayResp.stats;
+
+	loadgenStats.messages = resp->requests - loadgenReportRequests;
+	loadgenStats.busyNs = loadgenBusyNs;
+	loadgenReportRequests = resp->requests;
+	loadgenBusyNs = 0;
+
+	printf("loadgen: %u slaves, %u Delay_Req/s handled\n", loadgenSlaves, loadgenStats.messages / seconds);
+	printf("loadgen: injected %u, queue full %u, pbuf pool empty %u, task late %u\n",
+			loadgenStats.injected, loadgenStats.queueDrops, loadgenStats.allocFails, loadgenStats.lagged);
+	printf("loadgen: responses %u, rate drops %u, rate evictions %u, send drops %u\n",
+			loadgenStats.responses, resp->rateDrops, resp->rateEvictions, resp->sendDrops);
+	printf("loadgen: latency p50 < %u usec, p99 < %u usec, p99.9 < %u usec\n",
+			loadgenPercentile(500), loadgenPercentile(990), loadgenPercentile(999));
+
+	if (loadgenStats.messages > 0)
+	{
+		printf("loadgen: %u nsec per Delay_Req\n", (uint32_t)(loadgenStats.busyNs / loadgenStats.messages));
+	}
+}
+
+/* Inject the Delay_Req due since the last call, call it from the PTP task */
+void loadgenService(void)
+{
+	PtpClock *ptpClock = loadgenClock;
+	TimeInternal now, elapsed;
+	int16_t burst;
+
+	if (ptpClock == NULL) return;
+
+	getTime(&now);
+	subTime(&elapsed, &now, &loadgenLast);
+	loadgenLast = now;
+
+	if (ptpClock->portDS.portState != PTP_MASTER || ptpClock->portDS.delayMechanism != E2E ||
+			elapsed.seconds < 0 || elapsed.seconds >= LOADGEN_REPORT_S)
+	{
+		/* Not a master, or the clock was stepped */
+		loadgenCredit = 0;
+	}
+	else
+	{
+		loadgenCredit += ((uint64_t) elapsed.seconds * 1000000 + elapsed.nanoseconds / 1000) * loadgenSlaves;
+	}
+
+	for (burst = 0; burst < LOADGEN_BURST && loadgenCredit >= loadgenIntervalUs; burst++)
+	{
+		loadgenCredit -= loadgenIntervalUs;
+		loadgenInject(ptpClock, &now);
+	}
+
+	/* The task does not come back soon enough for the rate asked */
+	if (loadgenCredit >= loadgenIntervalUs)
+	{
+		loadgenStats.lagged += loadgenCredit / loadgenIntervalUs;
+		loadgenCredit %= loadgenIntervalUs;
+	}
+
+	if (now.seconds - loadgenReportSecond >= LOADGEN_REPORT_S)
+	{
+		loadgenReport(ptpClock, now.seconds - loadgenReportSecond);
+		loadgenReportSecond = now.seconds;
+	}
+}
+
+/* Account the Delay_Resp sent for a Delay_Req received at receipt */
+void loadgenResponse(const MsgHeader *header, const TimeInternal *receipt)
+{
+	TimeInternal now, latency;
+	int16_t bin;
+
+	if (!loadgenIsSlave(&header->sourcePortIdentity)) return;
+
+	getTime(&now);
+	subTime(&latency, &now, receipt);
+
+	if (latency.seconds < 0) return;
+
+	if (latency.seconds > 0)
+		bin = LOADGEN_LATENCY_BINS - 1;
+	else
+		bin = min(max(floorLog2(latency.nanoseconds / 1000), 0), LOADGEN_LATENCY_BINS - 1);
+
+	loadgenStats.latency[bin]++;
+	loadgenStats.responses++;
+}
+
+/* Account the time the PTP task spent in doState for ptpClock */
+void loadgenBusy(const PtpClock *ptpClock, const TimeInternal *start, const TimeInternal *end)
+{
+	TimeInternal busy;
+
+	if (ptpClock != loadgenClock) return;
+
+	subTime(&busy, end, start);
+	if (busy.seconds < 0) return;
+
+	loadgenBusyNs += (uint64_t) busy.seconds * 1000000000 + busy.nanoseconds;
+}
+
+void loadgenGetStats(LoadGenStats *stats)
+{
+	*stats = loadgenStats;
+}
+
+#endif /* PTPD_LOADGEN */
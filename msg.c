@@ -43,6 +43,50 @@ void msgPackHeader(const PtpClock *ptpClock, octet_t *buf)
 	*(uint8_t*)(buf + 33) = 0x7F; //Default value (spec Table 24)
 }
 
+/* Add scaled nanoseconds to the correctionField of a packed message */
+void msgAddCorrection(octet_t *buf, int64_t scaledNanoseconds)
+{
+	int64_t correction;
+	int32_t msb;
+	uint32_t lsb;
+
+	memcpy(&msb, (buf + 8), 4);
+	memcpy(&lsb, (buf + 12), 4);
+	correction = (int32_t)flip32(msb);
+	correction <<= 32;
+	correction += (uint32_t)flip32(lsb);
+
+	correction += scaledNanoseconds;
+
+	*(int32_t*)(buf + 8) = flip32(correction >> 32);
+	*(int32_t*)(buf + 12) = flip32((int32_t)correction);
+}
+
+/* Pack the Follow_Up of a one-step Sync forwarded by a two-step transparent clock */
+void msgPackFollowUpFromSync(octet_t *buf, const octet_t *sync)
+{
+	memcpy(buf, sync, FOLLOW_UP_LENGTH);
+
+	/* Changes in header */
+	*(char*)(buf + 0) = *(char*)(buf + 0) & 0xF0; //RAZ messageType
+	*(char*)(buf + 0) = *(char*)(buf + 0) | FOLLOW_UP; //Table 19
+	*(int16_t*)(buf + 2)  = flip16(FOLLOW_UP_LENGTH);
+	*(uint8_t*)(buf + 6) &= ~FLAG0_TWO_STEP;
+	memset((buf + 8), 0, 8); /* correction field */
+	*(uint8_t*)(buf + 32) = CTRL_FOLLOW_UP; //Table 23
+
+	/* preciseOriginTimestamp is the originTimestamp of the Sync */
+}
+
+/* Mark a packed message as sent to a unicast address or to the multicast group (Table 20) */
+void msgPackUnicastFlag(octet_t *buf, bool  unicast)
+{
+	if (unicast)
+		setFlag(*(uint8_t*)(buf + 6), FLAG0_UNICAST);
+	else
+		clearFlag(*(uint8_t*)(buf + 6), FLAG0_UNICAST);
+}
+
 /* Pack Announce message */
 void msgPackAnnounce(const PtpClock *ptpClock, octet_t *buf)
 {
@@ -54,6 +98,15 @@ void msgPackAnnounce(const PtpClock *ptpClock, octet_t *buf)
 	*(uint8_t*)(buf + 32) = CTRL_OTHER; /* Table 23 - controlField */
 	*(int8_t*)(buf + 33) = ptpClock->portDS.logAnnounceInterval;
 
+	/* Time properties (Table 20) */
+	*(uint8_t*)(buf + 7) = 0;
+	if (ptpClock->timePropertiesDS.leap61) setFlag(*(uint8_t*)(buf + 7), FLAG1_LEAP61);
+	if (ptpClock->timePropertiesDS.leap59) setFlag(*(uint8_t*)(buf + 7), FLAG1_LEAP59);
+	if (ptpClock->timePropertiesDS.currentUtcOffsetValid) setFlag(*(uint8_t*)(buf + 7), FLAG1_UTC_OFFSET_VALID);
+	if (ptpClock->timePropertiesDS.ptpTimescale) setFlag(*(uint8_t*)(buf + 7), FLAG1_PTP_TIMESCALE);
+	if (ptpClock->timePropertiesDS.timeTraceable) setFlag(*(uint8_t*)(buf + 7), FLAG1_TIME_TRACEABLE);
+	if (ptpClock->timePropertiesDS.frequencyTraceable) setFlag(*(uint8_t*)(buf + 7), FLAG1_FREQUENCY_TRACEABLE);
+
 	/* Announce message */
 	memset((buf + 34), 0, 10); /* originTimestamp */
 	*(int16_t*)(buf + 44) = flip16(ptpClock->timePropertiesDS.currentUtcOffset);
@@ -161,22 +214,32 @@ void msgUnpackFollowUp(const octet_t *buf, MsgFollowUp *follow)
 	follow->preciseOriginTimestamp.nanosecondsField = flip32(*(uint32_t*)(buf + 40));
 }
 
-/* Pack delayResp message */
-void msgPackDelayResp(const PtpClock *ptpClock, octet_t *buf, const MsgHeader *header, const Timestamp *receiveTimestamp)
+/* Pack the fields of a delayResp message which do not depend on the delayReq */
+void msgPackDelayRespTemplate(const PtpClock *ptpClock, octet_t *buf)
 {
 	/* Changes in header */
 	*(char*)(buf + 0) = *(char*)(buf + 0) & 0xF0; //RAZ messageType
 	*(char*)(buf + 0) = *(char*)(buf + 0) | DELAY_RESP; //Table 19
 	*(int16_t*)(buf + 2)  = flip16(DELAY_RESP_LENGTH);
 	/* *(uint8_t*)(buf+4) = header->domainNumber; */ /* TODO: Why? */
-	memset((buf + 8), 0, 8);
+	*(uint8_t*)(buf + 32) = CTRL_DELAY_RESP; //Table 23
+	*(int8_t*)(buf + 33) = ptpClock->portDS.logMinDelayReqInterval; //Table 24
+}
+
+/* Pack delayResp message */
+void msgPackDelayResp(const PtpClock *ptpClock, octet_t *buf, const MsgHeader *header, const Timestamp *receiveTimestamp)
+{
+	msgPackDelayRespTemplate(ptpClock, buf);
+	msgPackDelayRespFields(buf, header, receiveTimestamp);
+}
 
+/* Pack the fields of a delayResp message taken from the delayReq into a template */
+void msgPackDelayRespFields(octet_t *buf, const MsgHeader *header, const Timestamp *receiveTimestamp)
+{
 	/* Copy correctionField of  delayReqMessage */
 	*(int32_t*)(buf + 8) = flip32(header->correctionfield >> 32);
 	*(int32_t*)(buf + 12) = flip32((int32_t)header->correctionfield);
 	*(int16_t*)(buf + 30) = flip16(header->sequenceId);
-	*(uint8_t*)(buf + 32) = CTRL_DELAY_RESP; //Table 23
-	*(int8_t*)(buf + 33) = ptpClock->portDS.logMinDelayReqInterval; //Table 24
 
 	/* delay_resp message */
 	*(int16_t*)(buf + 34) = flip16(receiveTimestamp->secondsField.msb);
@@ -196,6 +259,138 @@ void msgUnpackDelayResp(const octet_t *buf, MsgDelayResp *resp)
 	resp->requestingPortIdentity.portNumber = flip16(*(int16_t*)(buf  + 52));
 }
 
+/* Pack Signaling message, the TLVs are appended by msgPackUnicastTLV */
+void msgPackSignaling(const PtpClock *ptpClock, octet_t *buf, const PortIdentity *targetPortIdentity)
+{
+	/* Changes in header */
+	*(char*)(buf + 0) = *(char*)(buf + 0) & 0xF0; //RAZ messageType
+	*(char*)(buf + 0) = *(char*)(buf + 0) | SIGNALING; //Table 19
+	*(int16_t*)(buf + 2)  = flip16(SIGNALING_LENGTH);
+	*(int16_t*)(buf + 30) = flip16(ptpClock->sentSignalingSequenceId);
+	*(uint8_t*)(buf + 32) = CTRL_OTHER; //Table 23
+	*(int8_t*)(buf + 33) = 0x7F; //Table 24
+	memset((buf + 8), 0, 8);
+
+	/* Signaling message */
+	memcpy((buf + 34), targetPortIdentity->clockIdentity, CLOCK_IDENTITY_LENGTH);
+	*(int16_t*)(buf + 42) = flip16(targetPortIdentity->portNumber);
+}
+
+/* Unpack Signaling message */
+void msgUnpackSignaling(const octet_t *buf, MsgSignaling *signaling)
+{
+	memcpy(signaling->targetPortIdentity.clockIdentity, (buf + 34), CLOCK_IDENTITY_LENGTH);
+	signaling->targetPortIdentity.portNumber = flip16(*(int16_t*)(buf + 42));
+}
+
+/* Append a unicast negotiation TLV to a Signaling message, returns the new messageLength */
+int16_t msgPackUnicastTLV(octet_t *buf, const MsgUnicastTLV *tlv)
+{
+	int16_t length = flip16(*(int16_t*)(buf + 2));
+	int16_t valueLength;
+	octet_t *value;
+
+	switch (tlv->tlvType)
+	{
+		case REQUEST_UNICAST_TRANSMISSION:
+			valueLength = 6;
+			break;
+		case GRANT_UNICAST_TRANSMISSION:
+			valueLength = 8;
+			break;
+		default:
+			valueLength = 2;
+			break;
+	}
+
+	if (length + TLV_HEADER_LENGTH + valueLength > PACKET_SIZE) return length;
+
+	*(int16_t*)(buf + length) = flip16(tlv->tlvType);
+	*(int16_t*)(buf + length + 2) = flip16(valueLength);
+	value = buf + length + TLV_HEADER_LENGTH;
+	memset(value, 0, valueLength);
+
+	*(uint8_t*)(value + 0) = tlv->messageType << 4;
+	if (valueLength >= 6)
+	{
+		*(int8_t*)(value + 1) = tlv->logInterMessagePeriod;
+		*(uint32_t*)(value + 2) = flip32(tlv->durationField);
+	}
+	if (valueLength >= 8 && tlv->renewalInvited)
+	{
+		*(uint8_t*)(value + 7) = 0x01;
+	}
+
+	length += TLV_HEADER_LENGTH + valueLength;
+	*(int16_t*)(buf + 2) = flip16(length);
+
+	return length;
+}
+
+/* Unpack the TLV at offset of a message of length octets, returns the offset of the next TLV, 0 at the end */
+int16_t msgUnpackUnicastTLV(const octet_t *buf, int16_t offset, int16_t length, MsgUnicastTLV *tlv)
+{
+	int16_t valueLength;
+	const octet_t *value;
+
+	if (offset + TLV_HEADER_LENGTH > length) return 0;
+
+	tlv->tlvType = flip16(*(int16_t*)(buf + offset));
+	valueLength = flip16(*(int16_t*)(buf + offset + 2));
+	if (valueLength < 0 || offset + TLV_HEADER_LENGTH + valueLength > length) return 0;
+
+	value = buf + offset + TLV_HEADER_LENGTH;
+	tlv->messageType = (valueLength >= 1) ? (*(uint8_t*)(value + 0)) >> 4 : 0;
+	tlv->logInterMessagePeriod = (valueLength >= 2) ? *(int8_t*)(value + 1) : 0;
+	tlv->durationField = (valueLength >= 6) ? flip32(*(uint32_t*)(value + 2)) : 0;
+	tlv->renewalInvited = (bool)(valueLength >= 8 && (*(uint8_t*)(value + 7) & 0x01));
+
+	return offset + TLV_HEADER_LENGTH + valueLength;
+}
+
+static const octet_t msgIntervalOrganization[6] = { 0x00, 0x80, 0xC2, 0x00, 0x00, 0x02 };
+
+/* Append a message interval request TLV to a Signaling message, returns the new messageLength */
+int16_t msgPackIntervalTLV(octet_t *buf, const MsgIntervalTLV *tlv)
+{
+	int16_t length = flip16(*(int16_t*)(buf + 2));
+	octet_t *value;
+
+	if (length + TLV_HEADER_LENGTH + INTERVAL_REQUEST_LENGTH > PACKET_SIZE) return length;
+
+	*(int16_t*)(buf + length) = flip16(ORGANIZATION_EXTENSION);
+	*(int16_t*)(buf + length + 2) = flip16(INTERVAL_REQUEST_LENGTH);
+	value = buf + length + TLV_HEADER_LENGTH;
+	memset(value, 0, INTERVAL_REQUEST_LENGTH);
+
+	memcpy(value, msgIntervalOrganization, sizeof(msgIntervalOrganization)); // organizationId and subType
+	*(int8_t*)(value + 6) = tlv->linkDelayInterval;
+	*(int8_t*)(value + 7) = tlv->timeSyncInterval;
+	*(int8_t*)(value + 8) = tlv->announceInterval;
+	*(uint8_t*)(value + 9) = tlv->flags;
+
+	length += TLV_HEADER_LENGTH + INTERVAL_REQUEST_LENGTH;
+	*(int16_t*)(buf + 2) = flip16(length);
+
+	return length;
+}
+
+/* Unpack the ORGANIZATION_EXTENSION TLV at offset, FALSE when it is not a message interval request */
+bool msgUnpackIntervalTLV(const octet_t *buf, int16_t offset, MsgIntervalTLV *tlv)
+{
+	const octet_t *value = buf + offset + TLV_HEADER_LENGTH;
+
+	if (flip16(*(int16_t*)(buf + offset + 2)) < INTERVAL_REQUEST_LENGTH - 2) return FALSE;
+	if (memcmp(value, msgIntervalOrganization, sizeof(msgIntervalOrganization))) return FALSE;
+
+	tlv->linkDelayInterval = *(int8_t*)(value + 6);
+	tlv->timeSyncInterval = *(int8_t*)(value + 7);
+	tlv->announceInterval = *(int8_t*)(value + 8);
+	tlv->flags = *(uint8_t*)(value + 9);
+
+	return TRUE;
+}
+
 /* Pack PdelayReq message */
 void msgPackPDelayReq(const PtpClock *ptpClock, octet_t *buf, const Timestamp *originTimestamp)
 {
@@ -1,17 +1,20 @@
 /* net.c */
 
 #include "../ptpd.h"
+#include "lwip/mld6.h"
+#include "lwip/prot/ethernet.h"
 
 /* Initialize network queue. */
 static void netQInit(BufQueue *queue)
 {
 	queue->head = 0;
 	queue->tail = 0;
+	queue->drops = 0;
 	//sys_mutex_new(&queue->mutex);
 }
 
 /* Put data to the network queue. */
-static bool netQPut(BufQueue *queue, void *pbuf)
+static bool netQPut(BufQueue *queue, void *pbuf, const ip_addr_t *addr)
 {
 	bool retval = FALSE;
 
@@ -23,8 +26,16 @@ static bool netQPut(BufQueue *queue, void *pbuf)
 		// Place the buffer in the queue.
 		queue->head = (queue->head + 1) & PBUF_QUEUE_MASK;
 		queue->pbuf[queue->head] = pbuf;
+		if (addr != NULL)
+			ip_addr_copy(queue->addr[queue->head], *addr);
+		else
+			ip_addr_set_zero(&queue->addr[queue->head]);
 		retval = TRUE;
 	}
+	else
+	{
+		queue->drops++;
+	}
 
 	//sys_mutex_unlock(&queue->mutex);
 
@@ -32,7 +43,7 @@ static bool netQPut(BufQueue *queue, void *pbuf)
 }
 
 /* Get data from the network queue. */
-static void *netQGet(BufQueue *queue)
+static void *netQGet(BufQueue *queue, ip_addr_t *addr)
 {
 	void *pbuf = NULL;
 
@@ -44,6 +55,7 @@ static void *netQGet(BufQueue *queue)
 		// Get the buffer from the queue.
 		queue->tail = (queue->tail + 1) & PBUF_QUEUE_MASK;
 		pbuf = queue->pbuf[queue->tail];
+		ip_addr_copy(*addr, queue->addr[queue->tail]);
 	}
 
 	//sys_mutex_unlock(&queue->mutex);
@@ -67,6 +79,9 @@ static void netQEmpty(BufQueue *queue)
 	//sys_mutex_unlock(&queue->mutex);
 }
 
+/* Instances using the IEEE 802.3 transport, fed by netEthernetInput. */
+static NetPath *netEthernetPaths[PTPD_NUMBER_INSTANCES];
+
 /* Check if something is in the queue */
 static bool netQCheck(BufQueue  *queue)
 {
@@ -84,13 +99,36 @@ static bool netQCheck(BufQueue  *queue)
 /* Shut down  the UDP and network stuff */
 bool netShutdown(NetPath *netPath)
 {
-	ip4_addr_t multicastAaddr;
-
 	DBG("netShutdown\n");
 
-	/* leave multicast group */
-	multicastAaddr.addr = netPath->multicastAddr;
-	igmp_leavegroup(IP_ADDR_ANY, &multicastAaddr);
+	if (netPath->transport == IEE_802_3)
+	{
+		int16_t i;
+
+		/* Stop receiving frames */
+		for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
+		{
+			if (netEthernetPaths[i] == netPath) netEthernetPaths[i] = NULL;
+		}
+
+		netQEmpty(&netPath->eventQ);
+		netQEmpty(&netPath->generalQ);
+		return TRUE;
+	}
+
+	/* leave multicast groups */
+#if LWIP_IPV6
+	if (netPath->transport == UDP_IPV6)
+	{
+		mld6_leavegroup_netif(netPath->netif, ip_2_ip6(&netPath->multicastAddr));
+		mld6_leavegroup_netif(netPath->netif, ip_2_ip6(&netPath->peerMulticastAddr));
+	}
+	else
+#endif
+	{
+		igmp_leavegroup_netif(netPath->netif, ip_2_ip4(&netPath->multicastAddr));
+		igmp_leavegroup_netif(netPath->netif, ip_2_ip4(&netPath->peerMulticastAddr));
+	}
 
 	/* Disconnect and close the Event UDP interface */
 	if (netPath->eventPcb)
@@ -109,23 +147,92 @@ bool netShutdown(NetPath *netPath)
 	}
 
 	/* Clear the network addresses. */
-	netPath->multicastAddr = 0;
-	netPath->unicastAddr = 0;
+	ip_addr_set_zero(&netPath->multicastAddr);
+	ip_addr_set_zero(&netPath->peerMulticastAddr);
+	ip_addr_set_zero(&netPath->unicastAddr);
 
 	/* Return a success code. */
 	return TRUE;
 }
 
 /* Find interface to  be used.  uuid should be filled with MAC address of the interface.
-	 Will return the IPv4 address of  the interface. */
+	 Will return the IPv4 address of  the interface. An empty name selects the default interface. */
 static int32_t findIface(const octet_t *ifaceName, octet_t *uuid, NetPath *netPath)
 {
 	struct netif *iface;
 
-	iface = netif_default;
+	if (ifaceName[0] != '\0')
+		iface = netif_find((const char *) ifaceName);
+	else
+		iface = netif_default;
+
+	if (iface == NULL)
+	{
+		ERROR("findIface: interface %s not found\n", ifaceName);
+		return 0;
+	}
+
+	netPath->netif = iface;
 	memcpy(uuid, iface->hwaddr, iface->hwaddr_len);
 
-	return iface->ip_addr.addr;
+	return ip4_addr_get_u32(netif_ip4_addr(iface));
+}
+
+/* Check the header of a received message before it takes a queue slot, the
+ * message types of Table 19 from this domain and another port are kept. */
+static bool netClassify(NetPath *netPath, const struct pbuf *p)
+{
+	const PtpClock *ptpClock = netPath->ptpClock;
+	octet_t header[HEADER_LENGTH];
+	uint16_t messageLength;
+	uint8_t messageType;
+
+	if (p->tot_len < HEADER_LENGTH || p->tot_len > PACKET_SIZE)
+	{
+		netPath->drops.length++;
+		return FALSE;
+	}
+
+	pbuf_copy_partial(p, header, HEADER_LENGTH, 0);
+
+	if ((header[1] & 0x0F) != ptpClock->portDS.versionNumber)
+	{
+		netPath->drops.version++;
+		return FALSE;
+	}
+
+	messageLength = flip16(*(uint16_t *)(header + 2));
+	if (messageLength < HEADER_LENGTH || messageLength > p->tot_len)
+	{
+		netPath->drops.length++;
+		return FALSE;
+	}
+
+	messageType = header[0] & 0x0F;
+	if ((messageType > PDELAY_RESP && messageType < FOLLOW_UP) || messageType > MANAGEMENT)
+	{
+		netPath->drops.type++;
+		return FALSE;
+	}
+
+#ifndef PTPD_TRANSPARENT_CLOCK
+	/* A transparent clock relays the messages of every domain */
+	if ((uint8_t) header[4] != ptpClock->defaultDS.domainNumber)
+	{
+		netPath->drops.domain++;
+		return FALSE;
+	}
+
+	/* Multicast loopback */
+	if (!memcmp(header + 20, ptpClock->portDS.portIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH) &&
+			flip16(*(uint16_t *)(header + 28)) == ptpClock->portDS.portIdentity.portNumber)
+	{
+		netPath->drops.self++;
+		return FALSE;
+	}
+#endif
+
+	return TRUE;
 }
 
 /* Process an incoming message on the Event port. */
@@ -134,8 +241,21 @@ static void netRecvEventCallback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
 {
 	NetPath *netPath = (NetPath *) arg;
 
+	/* Another instance owns the interface the message came in on. */
+	if (ip_current_input_netif() != netPath->netif)
+	{
+		pbuf_free(p);
+		return;
+	}
+
+	if (!netClassify(netPath, p))
+	{
+		pbuf_free(p);
+		return;
+	}
+
 	/* Place the incoming message on the Event Port QUEUE. */
-	if (!netQPut(&netPath->eventQ, p))
+	if (!netQPut(&netPath->eventQ, p, addr))
 	{
 		pbuf_free(p);
 		ERROR("netRecvEventCallback: queue full\n");
@@ -152,8 +272,21 @@ static void netRecvGeneralCallback(void *arg, struct udp_pcb *pcb, struct pbuf *
 {
 	NetPath *netPath = (NetPath *) arg;
 
-	/* Place the incoming message on the Event Port QUEUE. */
-	if (!netQPut(&netPath->generalQ, p))
+	/* Another instance owns the interface the message came in on. */
+	if (ip_current_input_netif() != netPath->netif)
+	{
+		pbuf_free(p);
+		return;
+	}
+
+	if (!netClassify(netPath, p))
+	{
+		pbuf_free(p);
+		return;
+	}
+
+	/* Place the incoming message on the General Port QUEUE. */
+	if (!netQPut(&netPath->generalQ, p, addr))
 	{
 		pbuf_free(p);
 		ERROR("netRecvGeneralCallback: queue full\n");
@@ -164,21 +297,183 @@ static void netRecvGeneralCallback(void *arg, struct udp_pcb *pcb, struct pbuf *
 	ptpd_alert();
 }
 
+/* Receive the PTP frames of the IEEE 802.3 transport, called by lwIP for
+ * every frame with an ethertype it does not handle. */
+err_t netEthernetInput(struct pbuf *p, struct netif *netif)
+{
+	struct eth_hdr *ethhdr;
+	BufQueue *queue;
+	bool  taken = FALSE;
+	int16_t i;
+
+	if (p->len < SIZEOF_ETH_HDR + HEADER_LENGTH) return ERR_ARG;
+
+	ethhdr = (struct eth_hdr *) p->payload;
+	if (ethhdr->type != PP_HTONS(PTP_ETHERTYPE)) return ERR_ARG;
+
+	/* Keep only the PTP message */
+	pbuf_remove_header(p, SIZEOF_ETH_HDR);
+
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
+	{
+		if (netEthernetPaths[i] == NULL || netEthernetPaths[i]->netif != netif) continue;
+		if (!netClassify(netEthernetPaths[i], p)) continue;
+
+		/* Event messages have the lower message types */
+		if ((*(uint8_t *) p->payload & 0x0F) < FOLLOW_UP)
+			queue = &netEthernetPaths[i]->eventQ;
+		else
+			queue = &netEthernetPaths[i]->generalQ;
+
+		/* Every instance on the interface holds a reference */
+		pbuf_ref(p);
+		if (!netQPut(queue, p, NULL))
+		{
+			pbuf_free(p);
+			ERROR("netEthernetInput: queue full\n");
+			continue;
+		}
+
+		taken = TRUE;
+	}
+
+	pbuf_free(p);
+
+	/* Alert the PTP thread there is now something to do. */
+	if (taken) ptpd_alert();
+
+	return ERR_OK;
+}
+
+/* Start the IEEE 802.3 transport on the interface found by netInit */
+static bool netInitEthernet(NetPath *netPath)
+{
+	int16_t i;
+
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
+	{
+		if (netEthernetPaths[i] == NULL)
+		{
+			netEthernetPaths[i] = netPath;
+			break;
+		}
+	}
+
+	/* Timestamp PTP frames and let 01-1B-19-00-00-00 and 01-80-C2-00-00-0E through */
+	ETH_PTPTimeStampEthernetCmd(ENABLE);
+	ETH_PassAllMulticastCmd(ENABLE);
+
+	return TRUE;
+}
+
+/* Join the IPv4 primary and peer delay groups */
+static bool netInitMulticast4(NetPath *netPath)
+{
+	struct in_addr netAddr;
+	char addrStr[NET_ADDRESS_LENGTH];
+
+	/* Init General multicast IP address */
+	memcpy(addrStr, DEFAULT_PTP_DOMAIN_ADDRESS, NET_ADDRESS_LENGTH);
+	if (!inet_aton(addrStr, &netAddr))
+	{
+			ERROR("netInit: failed to encode multi-cast address: %s\n", addrStr);
+			return FALSE;
+	}
+	ip_addr_set_ip4_u32(&netPath->multicastAddr, netAddr.s_addr);
+
+	/* Join multicast group (for receiving) on specified interface */
+	igmp_joingroup_netif(netPath->netif, ip_2_ip4(&netPath->multicastAddr));
+
+	/* Init Peer multicast IP address */
+	memcpy(addrStr, PEER_PTP_DOMAIN_ADDRESS, NET_ADDRESS_LENGTH);
+	if (!inet_aton(addrStr, &netAddr))
+	{
+			ERROR("netInit: failed to encode peer multi-cast address: %s\n", addrStr);
+			return FALSE;
+	}
+	ip_addr_set_ip4_u32(&netPath->peerMulticastAddr, netAddr.s_addr);
+
+	/* Join peer multicast group (for receiving) on specified interface */
+	igmp_joingroup_netif(netPath->netif, ip_2_ip4(&netPath->peerMulticastAddr));
+
+	/* Multicast send only on specified interface. */
+	netPath->eventPcb->multicast_ip.addr = ip4_addr_get_u32(ip_2_ip4(&netPath->multicastAddr));
+	netPath->generalPcb->multicast_ip.addr = ip4_addr_get_u32(ip_2_ip4(&netPath->multicastAddr));
+
+	return TRUE;
+}
+
+#if LWIP_IPV6
+/* Set addr to the group FF0x::id with x the scope, zoned to the interface */
+static void netMulticast6(ip_addr_t *addr, uint8_t scope, uint32_t id, struct netif *netif)
+{
+	IP_SET_TYPE(addr, IPADDR_TYPE_V6);
+	IP6_ADDR(ip_2_ip6(addr), lwip_htonl(0xFF000000UL | (uint32_t)(scope & 0x0F) << 16), 0, 0, lwip_htonl(id));
+	ip6_addr_assign_zone(ip_2_ip6(addr), IP6_MULTICAST, netif);
+}
+
+/* Join the IPv6 primary group at the configured scope and the link-local peer delay group */
+static bool netInitMulticast6(NetPath *netPath, uint8_t scope)
+{
+	if (scope < 0x01 || scope > 0x0E)
+	{
+			ERROR("netInit: invalid multi-cast scope: %d\n", scope);
+			return FALSE;
+	}
+
+	netMulticast6(&netPath->multicastAddr, scope, PTP_IPV6_GROUP_ID, netPath->netif);
+	netMulticast6(&netPath->peerMulticastAddr, PTP_IPV6_PEER_SCOPE, PTP_IPV6_PEER_GROUP_ID, netPath->netif);
+
+	if (mld6_joingroup_netif(netPath->netif, ip_2_ip6(&netPath->multicastAddr)) != ERR_OK ||
+			mld6_joingroup_netif(netPath->netif, ip_2_ip6(&netPath->peerMulticastAddr)) != ERR_OK)
+	{
+			ERROR("netInit: failed to join multi-cast groups\n");
+			return FALSE;
+	}
+
+	/* Timestamp the PTP messages carried in IPv6 */
+	ETH_PTPTimeStampIPv6Cmd(ENABLE);
+
+	return TRUE;
+}
+#endif
+
 /* Start  all of the UDP stuff */
 bool netInit(NetPath *netPath, PtpClock *ptpClock)
 {
-	struct in_addr netAddr;
 	ip4_addr_t interfaceAddr;
-	char addrStr[NET_ADDRESS_LENGTH];
+	const ip_addr_t *anyAddr = IP_ADDR_ANY;
+	u8_t addrType = IPADDR_TYPE_V4;
 
 	DBG("netInit\n");
 
 	/* Initialize the buffer queues. */
 	netQInit(&netPath->eventQ);
 	netQInit(&netPath->generalQ);
+	netPath->ptpClock = ptpClock;
+	memset(&netPath->drops, 0, sizeof(NetDrops));
 
 	/* Find a network interface */
+	netPath->netif = NULL;
+	netPath->transport = ptpClock->rtOpts->transport;
 	interfaceAddr.addr = findIface(ptpClock->rtOpts->ifaceName, ptpClock->portUuidField, netPath);
+
+	if (netPath->transport == IEE_802_3)
+	{
+		if (netPath->netif == NULL) goto fail01;
+		return netInitEthernet(netPath);
+	}
+
+#if LWIP_IPV6
+	if (netPath->transport == UDP_IPV6)
+	{
+		/* The link-local address is enough for IPv6 */
+		if (netPath->netif == NULL) goto fail01;
+		anyAddr = IP6_ADDR_ANY;
+		addrType = IPADDR_TYPE_V6;
+	}
+	else
+#endif
 	if (!(interfaceAddr.addr))
 	{
 			ERROR("netInit: Failed to find interface address\n");
@@ -186,7 +481,7 @@ bool netInit(NetPath *netPath, PtpClock *ptpClock)
 	}
 
 	/* Open lwIP raw udp interfaces for the event port. */
-	netPath->eventPcb = udp_new();
+	netPath->eventPcb = udp_new_ip_type(addrType);
 	if (NULL == netPath->eventPcb)
 	{
 			ERROR("netInit: Failed to open Event UDP PCB\n");
@@ -194,7 +489,7 @@ bool netInit(NetPath *netPath, PtpClock *ptpClock)
 	}
 
 	/* Open lwIP raw udp interfaces for the general port. */
-	netPath->generalPcb = udp_new();
+	netPath->generalPcb = udp_new_ip_type(addrType);
 	if (NULL == netPath->generalPcb)
 	{
 			ERROR("netInit: Failed to open General UDP PCB\n");
@@ -202,44 +497,34 @@ bool netInit(NetPath *netPath, PtpClock *ptpClock)
 	}
 
 	/* Configure network (broadcast/unicast) addresses. */
-	netPath->unicastAddr = 0; /* disable unicast */
+	ip_addr_set_zero(&netPath->unicastAddr); /* disable unicast */
 
-	/* Init General multicast IP address */
-	memcpy(addrStr, DEFAULT_PTP_DOMAIN_ADDRESS, NET_ADDRESS_LENGTH);
-	if (!inet_aton(addrStr, &netAddr))
+#if LWIP_IPV6
+	if (netPath->transport == UDP_IPV6)
 	{
-			ERROR("netInit: failed to encode multi-cast address: %s\n", addrStr);
-			goto fail04;
+		if (!netInitMulticast6(netPath, ptpClock->rtOpts->ipv6Scope)) goto fail04;
 	}
-	netPath->multicastAddr = netAddr.s_addr;
-
-	/* Join multicast group (for receiving) on specified interface */
-	igmp_joingroup(&interfaceAddr, (struct ip_addr *)&netAddr);
-
-	/* Init Peer multicast IP address */
-	memcpy(addrStr, PEER_PTP_DOMAIN_ADDRESS, NET_ADDRESS_LENGTH);
-	if (!inet_aton(addrStr, &netAddr))
+	else
+#endif
+	if (!netInitMulticast4(netPath))
 	{
-			ERROR("netInit: failed to encode peer multi-cast address: %s\n", addrStr);
-			goto fail04;
+		goto fail04;
 	}
-	netPath->peerMulticastAddr = netAddr.s_addr;
 
-	/* Join peer multicast group (for receiving) on specified interface */
-	igmp_joingroup(&interfaceAddr, (struct ip_addr *) &netAddr);
-
-	/* Multicast send only on specified interface. */
-	netPath->eventPcb->multicast_ip.addr = netPath->multicastAddr;
-	netPath->generalPcb->multicast_ip.addr = netPath->multicastAddr;
+#if SO_REUSE
+	/* Several instances may bind the PTP ports, each keeps the traffic of its own interface. */
+	ip_set_option(netPath->eventPcb, SOF_REUSEADDR);
+	ip_set_option(netPath->generalPcb, SOF_REUSEADDR);
+#endif
 
 	/* Establish the appropriate UDP bindings/connections for events. */
 	udp_recv(netPath->eventPcb, netRecvEventCallback, netPath);
-	udp_bind(netPath->eventPcb, IP_ADDR_ANY, PTP_EVENT_PORT);
+	udp_bind(netPath->eventPcb, anyAddr, PTP_EVENT_PORT);
 	/*  udp_connect(netPath->eventPcb, &netAddr, PTP_EVENT_PORT); */
 
 	/* Establish the appropriate UDP bindings/connections for general. */
 	udp_recv(netPath->generalPcb, netRecvGeneralCallback, netPath);
-	udp_bind(netPath->generalPcb, IP_ADDR_ANY, PTP_GENERAL_PORT);
+	udp_bind(netPath->generalPcb, anyAddr, PTP_GENERAL_PORT);
 	/*  udp_connect(netPath->generalPcb, &netAddr, PTP_GENERAL_PORT); */
 
 	/* Return a success code. */
@@ -271,7 +556,7 @@ void netEmptyEventQ(NetPath *netPath)
 	netQEmpty(&netPath->eventQ);
 }
 
-static ssize_t netRecv(octet_t *buf, TimeInternal *time, BufQueue *msgQueue)
+static ssize_t netRecv(octet_t *buf, TimeInternal *time, BufQueue *msgQueue, ip_addr_t *addr)
 {
 	int i;
 	int j;
@@ -280,7 +565,7 @@ static ssize_t netRecv(octet_t *buf, TimeInternal *time, BufQueue *msgQueue)
 	struct pbuf *pcopy;
 
 	/* Get the next buffer from the queue. */
-	if ((p = (struct pbuf*) netQGet(msgQueue)) == NULL)
+	if ((p = (struct pbuf*) netQGet(msgQueue, addr)) == NULL)
 	{
 		return 0;
 	}
@@ -337,17 +622,31 @@ static ssize_t netRecv(octet_t *buf, TimeInternal *time, BufQueue *msgQueue)
 	return length;
 }
 
+#ifdef PTPD_LOADGEN
+/* Place a message built by the load generator on the Event Port QUEUE, as if received. */
+bool netInjectEvent(NetPath *netPath, struct pbuf *p)
+{
+	if (!netQPut(&netPath->eventQ, p, NULL))
+	{
+		pbuf_free(p);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+#endif
+
 ssize_t netRecvEvent(NetPath *netPath, octet_t *buf, TimeInternal *time)
 {
-	return netRecv(buf, time, &netPath->eventQ);
+	return netRecv(buf, time, &netPath->eventQ, &netPath->lastRecvAddr);
 }
 
 ssize_t netRecvGeneral(NetPath *netPath, octet_t *buf, TimeInternal *time)
 {
-	return netRecv(buf, time, &netPath->generalQ);
+	return netRecv(buf, time, &netPath->generalQ, &netPath->lastRecvAddr);
 }
 
-static ssize_t netSend(const octet_t *buf, int16_t  length, TimeInternal *time, const int32_t * addr, struct udp_pcb * pcb)
+static ssize_t netSend(const octet_t *buf, int16_t  length, TimeInternal *time, const ip_addr_t * addr, struct udp_pcb * pcb, struct netif * netif)
 {
 	err_t result;
 	struct pbuf * p;
@@ -369,7 +668,7 @@ static ssize_t netSend(const octet_t *buf, int16_t  length, TimeInternal *time,
 	}
 
 	/* send the buffer. */
-	result = udp_sendto(pcb, p, (void *)addr, pcb->local_port);
+	result = udp_sendto_if(pcb, p, addr, pcb->local_port, netif);
 	if (ERR_OK != result)
 	{
 		ERROR("netSend: Failed to send data (%d)\n", result);
@@ -404,22 +703,78 @@ fail01:
 	/*  return (0 == result) ? length : 0; */
 }
 
-ssize_t netSendEvent(NetPath *netPath, const octet_t *buf, int16_t  length, TimeInternal *time)
+/* Send a PTP message in an Ethernet frame to the multicast MAC dst */
+static ssize_t netSendEthernet(const octet_t *buf, int16_t  length, TimeInternal *time, const octet_t *dst, struct netif * netif)
 {
-	return netSend(buf, length, time, &netPath->multicastAddr, netPath->eventPcb);
+	err_t result;
+	struct pbuf * p;
+	struct eth_hdr *ethhdr;
+
+	/* Allocate the tx pbuf with room for the Ethernet header. */
+	p = pbuf_alloc(PBUF_RAW, SIZEOF_ETH_HDR + length, PBUF_RAM);
+	if (NULL == p)
+	{
+		ERROR("netSendEthernet: Failed to allocate Tx Buffer\n");
+		return 0;
+	}
+
+	ethhdr = (struct eth_hdr *) p->payload;
+	memcpy(&ethhdr->dest, dst, ETH_HWADDR_LEN);
+	memcpy(&ethhdr->src, netif->hwaddr, ETH_HWADDR_LEN);
+	ethhdr->type = PP_HTONS(PTP_ETHERTYPE);
+	memcpy((u8_t *) p->payload + SIZEOF_ETH_HDR, buf, length);
+
+	/* send the frame, bypassing IP. */
+	result = netif->linkoutput(netif, p);
+	if (ERR_OK != result)
+	{
+		ERROR("netSendEthernet: Failed to send data (%d)\n", result);
+		length = 0;
+	}
+	else if (time != NULL)
+	{
+#if LWIP_PTP
+		time->seconds = p->time_sec;
+		time->nanoseconds = p->time_nsec;
+#else
+		getTime(time);
+#endif
+		DBGV("netSendEthernet: %d sec %d nsec\n", time->seconds, time->nanoseconds);
+	}
+
+	pbuf_free(p);
+
+	return length;
+}
+
+static const octet_t netEtherDst[ETH_HWADDR_LEN] = PTP_ETHER_DST;
+static const octet_t netEtherPeer[ETH_HWADDR_LEN] = PTP_ETHER_PEER;
+
+/* A NULL destination sends to the PTP multicast group */
+ssize_t netSendEvent(NetPath *netPath, const octet_t *buf, int16_t  length, TimeInternal *time, const ip_addr_t *destination)
+{
+	if (netPath->transport == IEE_802_3) return netSendEthernet(buf, length, time, netEtherDst, netPath->netif);
+
+	return netSend(buf, length, time, destination ? destination : &netPath->multicastAddr, netPath->eventPcb, netPath->netif);
 }
 
-ssize_t netSendGeneral(NetPath *netPath, const octet_t *buf, int16_t  length)
+ssize_t netSendGeneral(NetPath *netPath, const octet_t *buf, int16_t  length, const ip_addr_t *destination)
 {
-	return netSend(buf, length, NULL, &netPath->multicastAddr, netPath->generalPcb);
+	if (netPath->transport == IEE_802_3) return netSendEthernet(buf, length, NULL, netEtherDst, netPath->netif);
+
+	return netSend(buf, length, NULL, destination ? destination : &netPath->multicastAddr, netPath->generalPcb, netPath->netif);
 }
 
 ssize_t netSendPeerGeneral(NetPath *netPath, const octet_t *buf, int16_t  length)
 {
-	return netSend(buf, length, NULL, &netPath->peerMulticastAddr, netPath->generalPcb);
+	if (netPath->transport == IEE_802_3) return netSendEthernet(buf, length, NULL, netEtherPeer, netPath->netif);
+
+	return netSend(buf, length, NULL, &netPath->peerMulticastAddr, netPath->generalPcb, netPath->netif);
 }
 
 ssize_t netSendPeerEvent(NetPath *netPath, const octet_t *buf, int16_t  length, TimeInternal* time)
 {
-	return netSend(buf, length, time, &netPath->peerMulticastAddr, netPath->eventPcb);
+	if (netPath->transport == IEE_802_3) return netSendEthernet(buf, length, time, netEtherPeer, netPath->netif);
+
+	return netSend(buf, length, time, &netPath->peerMulticastAddr, netPath->eventPcb, netPath->netif);
 }
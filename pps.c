@@ -0,0 +1,121 @@
+/* pps.c */
+
+#include "../ptpd.h"
+
+/* Pulse train programmed on a flexible PPS channel */
+typedef struct
+{
+	bool running;
+	uint32_t intervalNs;
+	uint32_t widthNs;
+} PpsChannel;
+
+static PpsChannel ppsChannels[ETH_PTP_PPS_CHANNELS];
+
+/* First PTP second boundary which can still be programmed as a target time */
+static void ppsNextSecond(TimeInternal *start)
+{
+	getTime(start);
+	start->seconds += (start->nanoseconds < (1000000000 - PPS_START_MARGIN_NS)) ? 1 : 2;
+	start->nanoseconds = 0;
+}
+
+/* Program one channel and arm the start of its pulse train */
+static void ppsProgram(uint8_t channel, uint32_t intervalNs, uint32_t widthNs, const TimeInternal *start)
+{
+	if (ppsChannels[channel].running)
+	{
+		ETH_PTPPPSCommand(channel, ETH_PTP_PPSCMD_StopImmediately);
+	}
+
+	ETH_PTPSetPPSFlexible(channel, ENABLE);
+	ETH_PTPSetPPSInterval(channel, intervalNs, widthNs);
+	ETH_PTPSetPPSTargetTime(channel, start->seconds, start->nanoseconds);
+	ETH_PTPPPSCommand(channel, ETH_PTP_PPSCMD_StartTrain);
+
+	ppsChannels[channel].running = TRUE;
+	ppsChannels[channel].intervalNs = intervalNs;
+	ppsChannels[channel].widthNs = widthNs;
+
+	DBG("ppsProgram: channel %d interval %u nsec width %u nsec start %d sec %d nsec\n",
+			channel, intervalNs, widthNs, start->seconds, start->nanoseconds);
+}
+
+/* Start the same pulse train on every channel of channelMask. All channels share
+ * the start time, so the outputs stay phase aligned. Without a start time the
+ * trains start on the next PTP second boundary. A zero width gives a square wave. */
+bool ppsStartGroup(uint8_t channelMask, uint32_t intervalNs, uint32_t widthNs, const TimeInternal *start)
+{
+	TimeInternal startTime;
+	uint8_t channel;
+
+	if (!channelMask || (channelMask >> ETH_PTP_PPS_CHANNELS))
+	{
+		ERROR("ppsStartGroup: invalid channel mask 0x%x\n", channelMask);
+		return FALSE;
+	}
+
+	if (!intervalNs || widthNs >= intervalNs)
+	{
+		ERROR("ppsStartGroup: invalid interval %u nsec width %u nsec\n", intervalNs, widthNs);
+		return FALSE;
+	}
+
+	if (!widthNs) widthNs = intervalNs / 2;
+
+	if (start != NULL)
+	{
+		startTime = *start;
+	}
+	else
+	{
+		ppsNextSecond(&startTime);
+	}
+
+	for (channel = 0; channel < ETH_PTP_PPS_CHANNELS; channel++)
+	{
+		if (channelMask & (1 << channel))
+		{
+			ppsProgram(channel, intervalNs, widthNs, &startTime);
+		}
+	}
+
+	return TRUE;
+}
+
+bool ppsStart(uint8_t channel, uint32_t intervalNs, uint32_t widthNs, const TimeInternal *start)
+{
+	return ppsStartGroup(1 << channel, intervalNs, widthNs, start);
+}
+
+/* Phase aligned square waves, e.g. sampling clocks */
+bool ppsSquareWave(uint8_t channelMask, uint32_t intervalNs)
+{
+	return ppsStartGroup(channelMask, intervalNs, intervalNs / 2, NULL);
+}
+
+void ppsStop(uint8_t channel)
+{
+	if (!IS_ETH_PTP_PPS_CHANNEL(channel) || !ppsChannels[channel].running) return;
+
+	DBG("ppsStop: channel %d\n", channel);
+	ETH_PTPPPSCommand(channel, ETH_PTP_PPSCMD_StopImmediately);
+	ppsChannels[channel].running = FALSE;
+}
+
+/* Restart the running pulse trains on a second boundary after the clock was stepped */
+void ppsRealign(void)
+{
+	TimeInternal startTime;
+	uint8_t channel;
+
+	ppsNextSecond(&startTime);
+
+	for (channel = 0; channel < ETH_PTP_PPS_CHANNELS; channel++)
+	{
+		if (ppsChannels[channel].running)
+		{
+			ppsProgram(channel, ppsChannels[channel].intervalNs, ppsChannels[channel].widthNs, &startTime);
+		}
+	}
+}
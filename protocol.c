@@ -3,6 +3,7 @@
 #include "ptpd.h"
 
 static void handle(PtpClock*);
+static void handleMessage(PtpClock*, TimeInternal*);
 static void handleAnnounce(PtpClock*, bool);
 static void handleSync(PtpClock*, TimeInternal*, bool);
 static void handleFollowUp(PtpClock*, bool);
@@ -15,11 +16,20 @@ static void handleManagement(PtpClock*, bool);
 static void handleSignaling(PtpClock*, bool);
 
 static void issueDelayReqTimerExpired(PtpClock*);
-static void issueAnnounce(PtpClock*);
-static void issueSync(PtpClock*);
-static void issueFollowup(PtpClock*, const TimeInternal*);
-static void issueDelayReq(PtpClock*);
-static void issueDelayResp(PtpClock*, const TimeInternal*, const MsgHeader*);
+static void issueMasterMessage(PtpClock*, enum4bit_t, int8_t);
+static void issueAnnounce(PtpClock*, const ip_addr_t*);
+static void issueSync(PtpClock*, const ip_addr_t*);
+static void issueFollowup(PtpClock*, const TimeInternal*, const ip_addr_t*);
+static void issueDelayReq(PtpClock*, const ip_addr_t*);
+static void learnParentAddr(PtpClock*);
+static void syncReceived(PtpClock*);
+static void syncReceiptTimeout(PtpClock*);
+static uint32_t delayReqBurstSpacing(const PtpClock*);
+static void delayReqBurstStable(PtpClock*);
+static SyncPair *syncPairTake(PtpClock*, int16_t);
+static void syncPairComplete(PtpClock*, SyncPair*);
+static const ip_addr_t *delayReqDestination(const PtpClock*);
+static void issueDelayResp(PtpClock*, const TimeInternal*, const MsgHeader*, const ip_addr_t*);
 static void issuePDelayReq(PtpClock*);
 static void issuePDelayResp(PtpClock*, TimeInternal*, const MsgHeader*);
 static void issuePDelayRespFollowUp(PtpClock*, const TimeInternal*, const MsgHeader*);
@@ -60,9 +70,10 @@ void toState(PtpClock *ptpClock, uint8_t state)
 		case PTP_MASTER:
 
 			initClock(ptpClock);
-			timerStop(SYNC_INTERVAL_TIMER);
-			timerStop(ANNOUNCE_INTERVAL_TIMER);
-			timerStop(PDELAYREQ_INTERVAL_TIMER);
+			unicastRevoke(ptpClock);
+			timerStop(SYNC_INTERVAL_TIMER, ptpClock->itimer);
+			timerStop(ANNOUNCE_INTERVAL_TIMER, ptpClock->itimer);
+			timerStop(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
 			break;
 
 		case PTP_UNCALIBRATED:
@@ -72,14 +83,19 @@ void toState(PtpClock *ptpClock, uint8_t state)
 			{
 				break;
 			}
-			timerStop(ANNOUNCE_RECEIPT_TIMER);
+			timerStop(ANNOUNCE_RECEIPT_TIMER, ptpClock->itimer);
+			timerStop(SYNC_RECEIPT_TIMER, ptpClock->itimer);
+			ptpClock->holdover = FALSE;
+			ptpClock->failingOver = FALSE;
+			ptpClock->standby.active = FALSE;
+			ensembleReset(ptpClock);
 			switch (ptpClock->portDS.delayMechanism)
 			{
 				case E2E:
-					timerStop(DELAYREQ_INTERVAL_TIMER);
+					timerStop(DELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
 					break;
 				case P2P:
-					timerStop(PDELAYREQ_INTERVAL_TIMER);
+					timerStop(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
 					break;
 				default:
 					/* none */
@@ -92,20 +108,20 @@ void toState(PtpClock *ptpClock, uint8_t state)
 		case PTP_PASSIVE:
 
 			initClock(ptpClock);
-			timerStop(PDELAYREQ_INTERVAL_TIMER);
-			timerStop(ANNOUNCE_RECEIPT_TIMER);
+			timerStop(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
+			timerStop(ANNOUNCE_RECEIPT_TIMER, ptpClock->itimer);
 			break;
 
 		case PTP_LISTENING:
 
 			initClock(ptpClock);
-			timerStop(ANNOUNCE_RECEIPT_TIMER);
+			timerStop(ANNOUNCE_RECEIPT_TIMER, ptpClock->itimer);
 			break;
 
 		case PTP_PRE_MASTER:
 
 			initClock(ptpClock);
-			timerStop(QUALIFICATION_TIMEOUT);
+			timerStop(QUALIFICATION_TIMEOUT, ptpClock->itimer);
 			break;
 
 		default:
@@ -135,15 +151,26 @@ void toState(PtpClock *ptpClock, uint8_t state)
 
 		case PTP_LISTENING:
 
-			timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout) * (pow2ms(ptpClock->portDS.logAnnounceInterval)));
+			timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout) * (pow2us(ptpClock->portDS.logAnnounceInterval)), ptpClock->itimer);
 			ptpClock->portDS.portState = PTP_LISTENING;
 			ptpClock->recommendedState = PTP_LISTENING;
 			break;
 
 		case PTP_PRE_MASTER:
 
+#ifdef PTPD_BOUNDARY_CLOCK
+			/* 9.2.6.10 A port getting its time from another port (M3) qualifies
+			 * for N + 1 announce intervals, N being stepsRemoved */
+			if (memcmp(ptpClock->parentDS.grandmasterIdentity, ptpClock->defaultDS.clockIdentity, CLOCK_IDENTITY_LENGTH))
+			{
+				timerStart(QUALIFICATION_TIMEOUT, (ptpClock->currentDS.stepsRemoved + 1) * pow2us(ptpClock->portDS.logAnnounceInterval), ptpClock->itimer);
+				ptpClock->portDS.portState = PTP_PRE_MASTER;
+				break;
+			}
+#endif
+
 			/* If you implement not ordinary clock, you can manage this code */
-			/* timerStart(QUALIFICATION_TIMEOUT, pow2ms(DEFAULT_QUALIFICATION_TIMEOUT));
+			/* timerStart(QUALIFICATION_TIMEOUT, pow2us(DEFAULT_QUALIFICATION_TIMEOUT));
 			ptpClock->portDS.portState = PTP_PRE_MASTER;
 			break;
 			*/
@@ -151,9 +178,15 @@ void toState(PtpClock *ptpClock, uint8_t state)
 		case PTP_MASTER:
 
 			ptpClock->portDS.logMinDelayReqInterval = DEFAULT_DELAYREQ_INTERVAL; /* it may change during slave state */
-			timerStart(SYNC_INTERVAL_TIMER, pow2ms(ptpClock->portDS.logSyncInterval));
-			DBG("SYNC INTERVAL TIMER : %d \n", pow2ms(ptpClock->portDS.logSyncInterval));
-			timerStart(ANNOUNCE_INTERVAL_TIMER, pow2ms(ptpClock->portDS.logAnnounceInterval));
+			intervalReset(ptpClock);
+
+			/* Prepare the Delay_Resp template, the slaves start with a clean rate */
+			msgPackHeader(ptpClock, ptpClock->delayResp.buf);
+			msgPackDelayRespTemplate(ptpClock, ptpClock->delayResp.buf);
+			memset(ptpClock->delayResp.rates, 0, sizeof(ptpClock->delayResp.rates));
+			timerStart(SYNC_INTERVAL_TIMER, pow2us(ptpClock->portDS.logSyncInterval), ptpClock->itimer);
+			DBG("SYNC INTERVAL TIMER : %u usec\n", pow2us(ptpClock->portDS.logSyncInterval));
+			timerStart(ANNOUNCE_INTERVAL_TIMER, pow2us(ptpClock->portDS.logAnnounceInterval), ptpClock->itimer);
 
 			switch (ptpClock->portDS.delayMechanism)
 			{
@@ -161,7 +194,7 @@ void toState(PtpClock *ptpClock, uint8_t state)
 						/* none */
 						break;
 				case P2P:
-						timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2ms(ptpClock->portDS.logMinPdelayReqInterval) + 1));
+						timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2us(ptpClock->portDS.logMinPdelayReqInterval) + 1), ptpClock->itimer);
 						break;
 				default:
 						break;
@@ -173,10 +206,10 @@ void toState(PtpClock *ptpClock, uint8_t state)
 
 		case PTP_PASSIVE:
 
-			timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2ms(ptpClock->portDS.logAnnounceInterval)));
+			timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2us(ptpClock->portDS.logAnnounceInterval)), ptpClock->itimer);
 			if (ptpClock->portDS.delayMechanism == P2P)
 			{
-				timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2ms(ptpClock->portDS.logMinPdelayReqInterval + 1)));
+				timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2us(ptpClock->portDS.logMinPdelayReqInterval + 1)), ptpClock->itimer);
 			}
 			ptpClock->portDS.portState = PTP_PASSIVE;
 
@@ -184,25 +217,42 @@ void toState(PtpClock *ptpClock, uint8_t state)
 
 		case PTP_UNCALIBRATED:
 
-			timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2ms(ptpClock->portDS.logAnnounceInterval)));
+			timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2us(ptpClock->portDS.logAnnounceInterval)), ptpClock->itimer);
+			/* The Sync of a new parent are due within its announce receipt timeout, then within DEFAULT_SYNC_RECEIPT_TIMEOUT intervals */
+			timerStart(SYNC_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2us(ptpClock->portDS.logAnnounceInterval)), ptpClock->itimer);
 			switch (ptpClock->portDS.delayMechanism)
 			{
 				case E2E:
-						timerStart(DELAYREQ_INTERVAL_TIMER, getRand(pow2ms(ptpClock->portDS.logMinDelayReqInterval + 1)));
+						/* A burst gets a path delay before the offset is calibrated with none */
+						ptpClock->delayReqBurst = ptpClock->rtOpts->delayReqBurst;
+						ptpClock->burstDelay = 0;
+						timerStart(DELAYREQ_INTERVAL_TIMER, ptpClock->delayReqBurst ? delayReqBurstSpacing(ptpClock) :
+								getRand(pow2us(ptpClock->portDS.logMinDelayReqInterval + 1)), ptpClock->itimer);
 						break;
 				case P2P:
-						timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2ms(ptpClock->portDS.logMinPdelayReqInterval + 1)));
+						timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2us(ptpClock->portDS.logMinPdelayReqInterval + 1)), ptpClock->itimer);
 						break;
 				default:
 						/* none */
 						break;
 			}
+			ptpClock->uncalibratedSince = timerNow();
+			if (ptpClock->rtOpts->intervalRequests) intervalRequest(ptpClock, ptpClock->rtOpts->syncIntervalAcquire);
 			ptpClock->portDS.portState = PTP_UNCALIBRATED;
 
 			break;
 
 		case PTP_SLAVE:
 
+			if (ptpClock->portDS.portState == PTP_UNCALIBRATED)
+			{
+				ptpClock->calibrationMs = timerNow() - ptpClock->uncalibratedSince;
+				DBG("calibrated in %u ms\n", ptpClock->calibrationMs);
+			}
+
+			/* Locked, fewer Sync are enough */
+			if (ptpClock->rtOpts->intervalRequests) intervalRequest(ptpClock, ptpClock->rtOpts->syncIntervalLocked);
+
 			ptpClock->portDS.portState = PTP_SLAVE;
 
 			break;
@@ -218,7 +268,8 @@ static bool doInit(PtpClock *ptpClock)
 {
 	DBG("manufacturerIdentity: %s\n", MANUFACTURER_ID);
 
-	/* initialize networking */
+	/* initialize networking, the grants of a restarting port end first */
+	unicastShutdown(ptpClock);
 	netShutdown(&ptpClock->netPath);
 
 	if (!netInit(&ptpClock->netPath, ptpClock))
@@ -230,7 +281,12 @@ static bool doInit(PtpClock *ptpClock)
 	{
 		/* initialize other stuff */
 		initData(ptpClock);
-		initTimer();
+		initTimer(ptpClock->itimer);
+		unicastInit(ptpClock);
+		ensembleReset(ptpClock);
+		memset(&ptpClock->delayResp, 0, sizeof(DelayRespEngine));
+		memset(&ptpClock->bmcStats, 0, sizeof(BmcStats));
+		ptpClock->parentAddrKnown = FALSE;
 		initClock(ptpClock);
 		m1(ptpClock);
 		msgPackHeader(ptpClock, ptpClock->msgObuf);
@@ -241,8 +297,13 @@ static bool doInit(PtpClock *ptpClock)
 /* Handle actions and events for 'port_state' */
 void doState(PtpClock *ptpClock)
 {
+	bool  decided = FALSE;
+
 	ptpClock->messageActivity = FALSE;
 
+	/* Count down the unicast grants */
+	if (ptpClock->rtOpts->unicastNegotiation) unicastService(ptpClock);
+
 	switch (ptpClock->portDS.portState)
 	{
 		case PTP_LISTENING:
@@ -258,6 +319,8 @@ void doState(PtpClock *ptpClock)
 				DBGV("event STATE_DECISION_EVENT\n");
 				clearFlag(ptpClock->events, STATE_DECISION_EVENT);
 				ptpClock->recommendedState = bmc(ptpClock);
+				ptpClock->bmcStats.decisions++;
+				decided = TRUE;
 				DBGV("recommending state %s\n", stateString(ptpClock->recommendedState));
 
 				switch (ptpClock->recommendedState)
@@ -287,7 +350,7 @@ void doState(PtpClock *ptpClock)
 			switch (ptpClock->portDS.portState)
 			{
 				case PTP_PRE_MASTER:
-					if (timerExpired(QUALIFICATION_TIMEOUT)) toState(ptpClock, PTP_MASTER);
+					if (timerExpired(QUALIFICATION_TIMEOUT, ptpClock->itimer)) toState(ptpClock, PTP_MASTER);
 					break;
 				case PTP_MASTER:
 					break;
@@ -318,6 +381,7 @@ void doState(PtpClock *ptpClock)
 					{
 						DBG("event MASTER_CLOCK_CHANGED\n");
 						clearFlag(ptpClock->events, MASTER_CLOCK_CHANGED);
+						if ((ptpClock->rtOpts->hotStandby || ptpClock->rtOpts->ensemble) && standbyHandover(ptpClock)) toState(ptpClock, PTP_SLAVE);
 					}
 
 					break;
@@ -335,7 +399,8 @@ void doState(PtpClock *ptpClock)
 					{
 							DBG("event MASTER_CLOCK_CHANGED\n");
 							clearFlag(ptpClock->events, MASTER_CLOCK_CHANGED);
-							toState(ptpClock, PTP_UNCALIBRATED);
+							/* A warm standby keeps the servo locked */
+							if (!((ptpClock->rtOpts->hotStandby || ptpClock->rtOpts->ensemble) && standbyHandover(ptpClock))) toState(ptpClock, PTP_UNCALIBRATED);
 					}
 
 					break;
@@ -346,6 +411,10 @@ void doState(PtpClock *ptpClock)
 					break;
 			}
 
+			/* After the handover, the former parent may become the standby or join the ensemble */
+			if (decided && ptpClock->rtOpts->ensemble) ensembleSelect(ptpClock);
+			else if (decided && ptpClock->rtOpts->hotStandby) standbySelect(ptpClock);
+
 			break;
 
 		case PTP_LISTENING:
@@ -395,12 +464,25 @@ void doState(PtpClock *ptpClock)
 		case PTP_UNCALIBRATED:
 		case PTP_SLAVE:
 		case PTP_PASSIVE:
+		case PTP_PRE_MASTER:
 
-			if (timerExpired(ANNOUNCE_RECEIPT_TIMER))
+			if (timerExpired(ANNOUNCE_RECEIPT_TIMER, ptpClock->itimer))
 			{
 				DBGV("event ANNOUNCE_RECEIPT_TIMEOUT_EXPIRES for state %s\n", stateString(ptpClock->portDS.portState));
-				ptpClock->foreignMasterDS.count = 0;
-				ptpClock->foreignMasterDS.i = 0;
+				clearForeign(ptpClock);
+
+#ifdef PTPD_BOUNDARY_CLOCK
+				/* The other ports may still see a master, decide on all of them */
+				{
+					int16_t i;
+
+					for (i = 0; i < NUMBER_PORTS; i++)
+					{
+						setFlag(ptpClock->ports[i].events, STATE_DECISION_EVENT);
+					}
+				}
+				break;
+#endif
 
 				if (!(ptpClock->defaultDS.slaveOnly || ptpClock->defaultDS.clockQuality.clockClass == 255))
 				{
@@ -417,22 +499,29 @@ void doState(PtpClock *ptpClock)
 				break;
 			}
 
+			if (timerExpired(SYNC_RECEIPT_TIMER, ptpClock->itimer))
+			{
+				DBGV("event SYNC_RECEIPT_TIMEOUT_EXPIRES for state %s\n", stateString(ptpClock->portDS.portState));
+				syncReceiptTimeout(ptpClock);
+			}
+
 			handle(ptpClock);
 
 			break;
 
 		case PTP_MASTER:
 
-			if (timerExpired(SYNC_INTERVAL_TIMER))
+			if (timerExpired(SYNC_INTERVAL_TIMER, ptpClock->itimer))
 			{
 					DBGV("event SYNC_INTERVAL_TIMEOUT_EXPIRES for state PTP_MASTER\n");
-					issueSync(ptpClock);
+					issueMasterMessage(ptpClock, SYNC, ptpClock->portDS.logSyncInterval);
 			}
 
-			if (timerExpired(ANNOUNCE_INTERVAL_TIMER))
+			if (timerExpired(ANNOUNCE_INTERVAL_TIMER, ptpClock->itimer))
 			{
 					DBGV("event ANNOUNCE_INTERVAL_TIMEOUT_EXPIRES for state PTP_MASTER\n");
-					issueAnnounce(ptpClock);
+					issueMasterMessage(ptpClock, ANNOUNCE, ptpClock->portDS.logAnnounceInterval);
+					intervalService(ptpClock);
 			}
 
 			handle(ptpClock);
@@ -447,13 +536,14 @@ void doState(PtpClock *ptpClock)
 }
 
 
-/* Check and handle received messages */
+/* Check and handle the received messages, up to rxBudget of them, event messages first */
 static void handle(PtpClock *ptpClock)
 {
 
 		int ret;
-		bool  isFromSelf;
-		TimeInternal time = { 0, 0 };
+		uint16_t n;
+		uint8_t state = ptpClock->portDS.portState;
+		TimeInternal time;
 
 		if (FALSE == ptpClock->messageActivity)
 		{
@@ -474,35 +564,51 @@ static void handle(PtpClock *ptpClock)
 
 		DBGVV("handle: something\n");
 
-		/* Receive an event. */
-		ptpClock->msgIbufLength = netRecvEvent(&ptpClock->netPath, ptpClock->msgIbuf, &time);
-		/* local time is not UTC, we can calculate UTC on demand, otherwise UTC time is not used */
-		/* time.seconds += ptpClock->timePropertiesDS.currentUtcOffset; */
-		DBGV("handle: netRecvEvent returned %d\n", ptpClock->msgIbufLength);
-
-		if (ptpClock->msgIbufLength < 0)
-		{
-				ERROR("handle: failed to receive on the event socket\n");
-				toState(ptpClock, PTP_FAULTY);
-				return;
-		}
-		else if (!ptpClock->msgIbufLength)
+		/* The timers and the state decision wait for the end of the batch,
+			 a change of state ends it so the new state gets its actions first */
+		for (n = 0; n < ptpClock->rtOpts->rxBudget && ptpClock->portDS.portState == state; n++)
 		{
-				/* Receive a general packet. */
-				ptpClock->msgIbufLength = netRecvGeneral(&ptpClock->netPath, ptpClock->msgIbuf, &time);
-				DBGV("handle: netRecvGeneral returned %d\n", ptpClock->msgIbufLength);
+				time.seconds = 0;
+				time.nanoseconds = 0;
+
+				/* Receive an event. */
+				ptpClock->msgIbufLength = netRecvEvent(&ptpClock->netPath, ptpClock->msgIbuf, &time);
+				/* local time is not UTC, we can calculate UTC on demand, otherwise UTC time is not used */
+				/* time.seconds += ptpClock->timePropertiesDS.currentUtcOffset; */
+				DBGV("handle: netRecvEvent returned %d\n", ptpClock->msgIbufLength);
 
 				if (ptpClock->msgIbufLength < 0)
 				{
-						ERROR("handle: failed to receive on the general socket\n");
+						ERROR("handle: failed to receive on the event socket\n");
 						toState(ptpClock, PTP_FAULTY);
 						return;
 				}
 				else if (!ptpClock->msgIbufLength)
-						return;
+				{
+						/* Receive a general packet. */
+						ptpClock->msgIbufLength = netRecvGeneral(&ptpClock->netPath, ptpClock->msgIbuf, &time);
+						DBGV("handle: netRecvGeneral returned %d\n", ptpClock->msgIbufLength);
+
+						if (ptpClock->msgIbufLength < 0)
+						{
+								ERROR("handle: failed to receive on the general socket\n");
+								toState(ptpClock, PTP_FAULTY);
+								return;
+						}
+						else if (!ptpClock->msgIbufLength)
+								return;
+				}
+
+				ptpClock->messageActivity = TRUE;
+
+				handleMessage(ptpClock, &time);
 		}
+}
 
-		ptpClock->messageActivity = TRUE;
+/* Dispatch the message in msgIbuf, time is its receive timestamp */
+static void handleMessage(PtpClock *ptpClock, TimeInternal *time)
+{
+		bool  isFromSelf;
 
 		if (ptpClock->msgIbufLength < HEADER_LENGTH)
 		{
@@ -520,6 +626,11 @@ static void handle(PtpClock *ptpClock)
 				return;
 		}
 
+#ifdef PTPD_TRANSPARENT_CLOCK
+		/* Relay messages of every domain to the other ports */
+		tcForward(ptpClock, time);
+#endif
+
 		if (ptpClock->msgTmpHeader.domainNumber != ptpClock->defaultDS.domainNumber)
 		{
 				DBGV("handle: ignore message from domainNumber %d\n", ptpClock->msgTmpHeader.domainNumber);
@@ -533,8 +644,8 @@ static void handle(PtpClock *ptpClock)
 
 		/* Subtract the inbound latency adjustment if it is not a loop back and the
 			 time stamp seems reasonable */
-		if (!isFromSelf && time.seconds > 0)
-				subTime(&time, &time, &ptpClock->inboundLatency);
+		if (!isFromSelf && time->seconds > 0)
+				subTime(time, time, &ptpClock->inboundLatency);
 
 		switch (ptpClock->msgTmpHeader.messageType)
 		{
@@ -544,7 +655,7 @@ static void handle(PtpClock *ptpClock)
 				break;
 
 		case SYNC:
-				handleSync(ptpClock, &time, isFromSelf);
+				handleSync(ptpClock, time, isFromSelf);
 				break;
 
 		case FOLLOW_UP:
@@ -552,11 +663,11 @@ static void handle(PtpClock *ptpClock)
 				break;
 
 		case DELAY_REQ:
-				handleDelayReq(ptpClock, &time, isFromSelf);
+				handleDelayReq(ptpClock, time, isFromSelf);
 				break;
 
 		case PDELAY_REQ:
-				handlePDelayReq(ptpClock, &time, isFromSelf);
+				handlePDelayReq(ptpClock, time, isFromSelf);
 				break;
 
 		case DELAY_RESP:
@@ -564,7 +675,7 @@ static void handle(PtpClock *ptpClock)
 				break;
 
 		case PDELAY_RESP:
-				handlePDelayResp(ptpClock, &time, isFromSelf);
+				handlePDelayResp(ptpClock, time, isFromSelf);
 				break;
 
 		case PDELAY_RESP_FOLLOW_UP:
@@ -585,6 +696,30 @@ static void handle(PtpClock *ptpClock)
 		}
 }
 
+/* The BMC runs again only when Erbest or the qualified records changed */
+static void announceDecision(PtpClock *ptpClock)
+{
+	if (!ptpClock->foreignMasterDS.changed)
+	{
+		ptpClock->bmcStats.avoided++;
+		return;
+	}
+
+#ifdef PTPD_BOUNDARY_CLOCK
+	/* Ebest spans the ports, a new Erbest may change the state of another */
+	{
+		int16_t i;
+
+		for (i = 0; i < NUMBER_PORTS; i++)
+		{
+			setFlag(ptpClock->ports[i].events, STATE_DECISION_EVENT);
+		}
+	}
+#else
+	setFlag(ptpClock->events, STATE_DECISION_EVENT);
+#endif
+}
+
 /* spec 9.5.3 */
 static void handleAnnounce(PtpClock *ptpClock, bool isFromSelf)
 {
@@ -617,17 +752,18 @@ static void handleAnnounce(PtpClock *ptpClock, bool isFromSelf)
 		case PTP_UNCALIBRATED:
 		case PTP_SLAVE:
 
-			/* Valid announce message is received : BMC algorithm will be executed */
-			setFlag(ptpClock->events, STATE_DECISION_EVENT);
 			isFromCurrentParent = isSamePortIdentity(
 			&ptpClock->parentDS.parentPortIdentity,
 			&ptpClock->msgTmpHeader.sourcePortIdentity);
 			msgUnpackAnnounce(ptpClock->msgIbuf, &ptpClock->msgTmp.announce);
 			if (isFromCurrentParent)
 			{
+					learnParentAddr(ptpClock);
+					/* The record of the parent stays qualified for the BMC */
+					addForeign(ptpClock, &ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce);
 					s1(ptpClock, &ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce);
 					/* Reset  Timer handling Announce receipt timeout */
-					timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout) * (pow2ms(ptpClock->portDS.logAnnounceInterval)));
+					timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout) * (pow2us(ptpClock->portDS.logAnnounceInterval)), ptpClock->itimer);
 			}
 			else
 			{
@@ -636,10 +772,12 @@ static void handleAnnounce(PtpClock *ptpClock, bool isFromSelf)
 				addForeign(ptpClock, &ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce);
 			}
 
+			/* Valid announce message is received : BMC algorithm will be executed if needed */
+			announceDecision(ptpClock);
 			break;
 
 		case PTP_PASSIVE:
-				timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2ms(ptpClock->portDS.logAnnounceInterval)));
+				timerStart(ANNOUNCE_RECEIPT_TIMER, (ptpClock->portDS.announceReceiptTimeout)*(pow2us(ptpClock->portDS.logAnnounceInterval)), ptpClock->itimer);
 		case PTP_MASTER:
 		case PTP_PRE_MASTER:
 		case PTP_LISTENING:
@@ -648,9 +786,9 @@ static void handleAnnounce(PtpClock *ptpClock, bool isFromSelf)
 			DBGV("handleAnnounce: from another foreign master\n");
 			msgUnpackAnnounce(ptpClock->msgIbuf, &ptpClock->msgTmp.announce);
 
-			/* Valid announce message is received : BMC algorithm will be executed */
-			setFlag(ptpClock->events, STATE_DECISION_EVENT);
+			/* Valid announce message is received : BMC algorithm will be executed if needed */
 			addForeign(ptpClock, &ptpClock->msgTmpHeader, &ptpClock->msgTmp.announce);
+			announceDecision(ptpClock);
 
 			break;
 	}
@@ -661,6 +799,7 @@ static void handleSync(PtpClock *ptpClock, TimeInternal *time, bool isFromSelf)
 	TimeInternal originTimestamp;
 	TimeInternal correctionField;
 	bool  isFromCurrentParent = FALSE;
+	SyncPair *pair;
 
 	DBGV("handleSync: received in state %s\n", stateString(ptpClock->portDS.portState));
 
@@ -696,23 +835,34 @@ static void handleSync(PtpClock *ptpClock, TimeInternal *time, bool isFromSelf)
 			if (!isFromCurrentParent)
 			{
 				DBGV("handleSync: ignore from another master\n");
+				if (ptpClock->rtOpts->hotStandby || ptpClock->rtOpts->ensemble) standbySync(ptpClock, time);
 				break;
 			}
 
+			learnParentAddr(ptpClock);
+			syncReceived(ptpClock);
+			intervalSync(ptpClock);
 			ptpClock->timestamp_syncRecieve = *time;
 			scaledNanosecondsToInternalTime(&ptpClock->msgTmpHeader.correctionfield, &correctionField);
 
 			if (getFlag(ptpClock->msgTmpHeader.flagField[0], FLAG0_TWO_STEP))
 			{
-				ptpClock->waitingForFollowUp = TRUE;
-				ptpClock->recvSyncSequenceId = ptpClock->msgTmpHeader.sequenceId;
+				pair = syncPairTake(ptpClock, ptpClock->msgTmpHeader.sequenceId);
+				if (pair->sync)
+				{
+					DBGV("handleSync: duplicate\n");
+					break;
+				}
+
+				pair->sync = TRUE;
+				pair->syncReceipt = *time;
 				/* Save correctionField of Sync message for future use */
-				ptpClock->correctionField_sync = correctionField;
+				addTime(&pair->correctionField, &pair->correctionField, &correctionField);
+				syncPairComplete(ptpClock, pair);
 			}
 			else
 			{
 				msgUnpackSync(ptpClock->msgIbuf, &ptpClock->msgTmp.sync);
-				ptpClock->waitingForFollowUp = FALSE;
 				/* Synchronize  local clock */
 				toInternalTime(&originTimestamp, &ptpClock->msgTmp.sync.originTimestamp);
 				/* use correctionField of Sync message for future use */
@@ -761,9 +911,9 @@ static void handleSync(PtpClock *ptpClock, TimeInternal *time, bool isFromSelf)
 
 static void handleFollowUp(PtpClock *ptpClock, bool isFromSelf)
 {
-	TimeInternal preciseOriginTimestamp;
 	TimeInternal correctionField;
 	bool  isFromCurrentParent = FALSE;
+	SyncPair *pair;
 
 	DBGV("handleFollowup: received in state %s\n", stateString(ptpClock->portDS.portState));
 
@@ -797,35 +947,28 @@ static void handleFollowUp(PtpClock *ptpClock, bool isFromSelf)
 			&ptpClock->parentDS.parentPortIdentity,
 			&ptpClock->msgTmpHeader.sourcePortIdentity);
 
-			if (!ptpClock->waitingForFollowUp)
-			{
-				DBGV("handleFollowup: not waiting a message\n");
-				break;
-			}
-
 			if (!isFromCurrentParent)
 			{
 				DBGV("handleFollowup: not from current parent\n");
+				if (ptpClock->rtOpts->hotStandby || ptpClock->rtOpts->ensemble) standbyFollowUp(ptpClock);
 				break;
 			}
 
-			if (ptpClock->recvSyncSequenceId !=  ptpClock->msgTmpHeader.sequenceId)
+			msgUnpackFollowUp(ptpClock->msgIbuf, &ptpClock->msgTmp.follow);
+
+			/* The Follow_Up may come before its Sync, which then completes the pair */
+			pair = syncPairTake(ptpClock, ptpClock->msgTmpHeader.sequenceId);
+			if (pair->followUp)
 			{
-				DBGV("handleFollowup: SequenceID doesn't match with last Sync message\n");
+				DBGV("handleFollowup: duplicate\n");
 				break;
 			}
 
-			msgUnpackFollowUp(ptpClock->msgIbuf, &ptpClock->msgTmp.follow);
-
-			ptpClock->waitingForFollowUp = FALSE;
-			/* synchronize local clock */
-			toInternalTime(&preciseOriginTimestamp, &ptpClock->msgTmp.follow.preciseOriginTimestamp);
+			pair->followUp = TRUE;
+			toInternalTime(&pair->preciseOriginTimestamp, &ptpClock->msgTmp.follow.preciseOriginTimestamp);
 			scaledNanosecondsToInternalTime(&ptpClock->msgTmpHeader.correctionfield, &correctionField);
-			addTime(&correctionField, &correctionField, &ptpClock->correctionField_sync);
-			updateOffset(ptpClock, &ptpClock->timestamp_syncRecieve, &preciseOriginTimestamp, &correctionField);
-			updateClock(ptpClock);
-
-			issueDelayReqTimerExpired(ptpClock);
+			addTime(&pair->correctionField, &pair->correctionField, &correctionField);
+			syncPairComplete(ptpClock, pair);
 			break;
 
 		case PTP_MASTER:
@@ -849,6 +992,8 @@ static void handleFollowUp(PtpClock *ptpClock, bool isFromSelf)
 
 static void handleDelayReq(PtpClock *ptpClock, TimeInternal *time, bool isFromSelf)
 {
+	UnicastGrant *grant;
+
 	switch (ptpClock->portDS.delayMechanism)
 	{
 		case E2E:
@@ -887,7 +1032,23 @@ static void handleDelayReq(PtpClock *ptpClock, TimeInternal *time, bool isFromSe
 
 				case PTP_MASTER:
 					/* TODO: manage the value of ptpClock->logMinDelayReqInterval form logSyncInterval to logSyncInterval + 5 */
-					issueDelayResp(ptpClock, time, &ptpClock->msgTmpHeader);
+					if (!ptpClock->rtOpts->unicastNegotiation)
+					{
+						/* A hybrid slave is answered in unicast, to the source of its Delay_Req */
+						issueDelayResp(ptpClock, time, &ptpClock->msgTmpHeader,
+								getFlag(ptpClock->msgTmpHeader.flagField[0], FLAG0_UNICAST) ? &ptpClock->netPath.lastRecvAddr : NULL);
+						break;
+					}
+
+					/* Only the slaves granted Delay_Resp get one */
+					grant = unicastFindGrant(ptpClock, &ptpClock->msgTmpHeader.sourcePortIdentity, DELAY_RESP);
+					if (grant == NULL)
+					{
+						DBGV("handleDelayReq: no unicast grant\n");
+						break;
+					}
+
+					issueDelayResp(ptpClock, time, &ptpClock->msgTmpHeader, &grant->addr);
 					break;
 
 				default:
@@ -916,6 +1077,7 @@ static void handleDelayResp(PtpClock *ptpClock, bool  isFromSelf)
 	bool  isFromCurrentParent = FALSE;
 	bool  isCurrentRequest = FALSE;
 	TimeInternal correctionField;
+	DelayReqSent *request;
 
 	switch (ptpClock->portDS.delayMechanism)
 	{
@@ -951,15 +1113,32 @@ static void handleDelayResp(PtpClock *ptpClock, bool  isFromSelf)
 					&ptpClock->portDS.portIdentity,
 					&ptpClock->msgTmp.resp.requestingPortIdentity);
 
-					if (((ptpClock->sentDelayReqSequenceId - 1) == ptpClock->msgTmpHeader.sequenceId) && isCurrentRequest && isFromCurrentParent)
+					/* Any Delay_Req still in flight may be answered, not only the last one */
+					request = &ptpClock->delayReqs[ptpClock->msgTmpHeader.sequenceId & DELAYREQ_INFLIGHT_MASK];
+
+					/* Multicast Delay_Req are answered by every master, the standby and the ensemble too */
+					if (isCurrentRequest && !isFromCurrentParent && (ptpClock->rtOpts->hotStandby || ptpClock->rtOpts->ensemble))
 					{
+						standbyDelayResp(ptpClock, request);
+					}
+					else if (request->pending && request->sequenceId == ptpClock->msgTmpHeader.sequenceId && isCurrentRequest && isFromCurrentParent)
+					{
+						request->pending = FALSE;
+
+						if (timerNow() - request->sent > DELAYREQ_TIMEOUT_INTERVALS * pow2ms(ptpClock->portDS.logMinDelayReqInterval + 1))
+						{
+							DBGV("handleDelayResp: delayReq %d timed out\n", (uint16_t) request->sequenceId);
+							break;
+						}
+
 						/* TODO: revisit 11.3 */
 						toInternalTime(&ptpClock->timestamp_delayReqRecieve, &ptpClock->msgTmp.resp.receiveTimestamp);
 
 						scaledNanosecondsToInternalTime(&ptpClock->msgTmpHeader.correctionfield, &correctionField);
-						updateDelay(ptpClock, &ptpClock->timestamp_delayReqSend, &ptpClock->timestamp_delayReqRecieve, &correctionField);
+						updateDelay(ptpClock, &request->timestamp, &ptpClock->timestamp_delayReqRecieve, &correctionField);
+						delayReqBurstStable(ptpClock);
 
-						ptpClock->portDS.logMinDelayReqInterval = ptpClock->msgTmpHeader.logMessageInterval;
+						ptpClock->portDS.logMinDelayReqInterval = max(ptpClock->msgTmpHeader.logMessageInterval, LOG_INTERVAL_MIN);
 					}
 					else
 					{
@@ -1232,6 +1411,41 @@ static void handleManagement(PtpClock *ptpClock, bool isFromSelf)
 
 static void handleSignaling(PtpClock *ptpClock, bool  isFromSelf)
 {
+	DBGV("handleSignaling: received in state %s\n", stateString(ptpClock->portDS.portState));
+
+	if (ptpClock->msgIbufLength < SIGNALING_LENGTH)
+	{
+		ERROR("handleSignaling: short message\n");
+		toState(ptpClock, PTP_FAULTY);
+		return;
+	}
+
+	if (isFromSelf)
+	{
+		DBGV("handleSignaling: ignore from self\n");
+		return;
+	}
+
+	if (!ptpClock->rtOpts->unicastNegotiation && !ptpClock->rtOpts->intervalRequests)
+	{
+		DBGV("handleSignaling: disreguard\n");
+		return;
+	}
+
+	switch (ptpClock->portDS.portState)
+	{
+		case PTP_INITIALIZING:
+		case PTP_FAULTY:
+		case PTP_DISABLED:
+
+			DBGV("handleSignaling: disreguard\n");
+			break;
+
+		default:
+
+			unicastSignaling(ptpClock);
+			break;
+	}
 }
 
 static void issueDelayReqTimerExpired(PtpClock *ptpClock)
@@ -1240,25 +1454,28 @@ static void issueDelayReqTimerExpired(PtpClock *ptpClock)
 	{
 		case E2E:
 
-			if (ptpClock->portDS.portState != PTP_SLAVE)
+			if (ptpClock->portDS.portState != PTP_SLAVE && ptpClock->portDS.portState != PTP_UNCALIBRATED)
 			{
 					break;
 			}
 
-			if (timerExpired(DELAYREQ_INTERVAL_TIMER))
+			if (timerExpired(DELAYREQ_INTERVAL_TIMER, ptpClock->itimer))
 			{
-					timerStart(DELAYREQ_INTERVAL_TIMER, getRand(pow2ms(ptpClock->portDS.logMinDelayReqInterval + 1)));
+					if (ptpClock->delayReqBurst > 0 && --ptpClock->delayReqBurst > 0)
+							timerStart(DELAYREQ_INTERVAL_TIMER, delayReqBurstSpacing(ptpClock), ptpClock->itimer);
+					else
+							timerStart(DELAYREQ_INTERVAL_TIMER, getRand(pow2us(ptpClock->portDS.logMinDelayReqInterval + 1)), ptpClock->itimer);
 					DBGV("event DELAYREQ_INTERVAL_TIMEOUT_EXPIRES\n");
-					issueDelayReq(ptpClock);
+					issueDelayReq(ptpClock, delayReqDestination(ptpClock));
 			}
 
 			break;
 
 		case P2P:
 
-			if (timerExpired(PDELAYREQ_INTERVAL_TIMER))
+			if (timerExpired(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer))
 			{
-					timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2ms(ptpClock->portDS.logMinPdelayReqInterval + 1)));
+					timerStart(PDELAYREQ_INTERVAL_TIMER, getRand(pow2us(ptpClock->portDS.logMinPdelayReqInterval + 1)), ptpClock->itimer);
 					DBGV("event PDELAYREQ_INTERVAL_TIMEOUT_EXPIRES\n");
 					issuePDelayReq(ptpClock);
 			}
@@ -1270,12 +1487,40 @@ static void issueDelayReqTimerExpired(PtpClock *ptpClock)
 }
 
 
-/* Pack and send  on general multicast ip adress an Announce message */
-static void issueAnnounce(PtpClock *ptpClock)
+/* Send a Sync or an Announce to the multicast group, or to the unicast grantees it is due to */
+static void issueMasterMessage(PtpClock *ptpClock, enum4bit_t messageType, int8_t logInterval)
+{
+	UnicastGrant *grant;
+	int16_t i;
+
+	if (!ptpClock->rtOpts->unicastNegotiation)
+	{
+		if (messageType == SYNC)
+			issueSync(ptpClock, NULL);
+		else
+			issueAnnounce(ptpClock, NULL);
+		return;
+	}
+
+	for (i = 0; i < UNICAST_MAX_GRANTS && ptpClock->portDS.portState == PTP_MASTER; i++)
+	{
+		grant = &ptpClock->unicastGrants[i];
+		if (!unicastGrantDue(grant, messageType, logInterval)) continue;
+
+		if (messageType == SYNC)
+			issueSync(ptpClock, &grant->addr);
+		else
+			issueAnnounce(ptpClock, &grant->addr);
+	}
+}
+
+/* Pack and send  on general multicast ip adress, or to destination, an Announce message */
+static void issueAnnounce(PtpClock *ptpClock, const ip_addr_t *destination)
 {
 	msgPackAnnounce(ptpClock, ptpClock->msgObuf);
+	msgPackUnicastFlag(ptpClock->msgObuf, destination != NULL);
 
-	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, ANNOUNCE_LENGTH))
+	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, ANNOUNCE_LENGTH, destination))
 	{
 		ERROR("issueAnnounce: can't sent\n");
 		toState(ptpClock, PTP_FAULTY);
@@ -1287,8 +1532,8 @@ static void issueAnnounce(PtpClock *ptpClock)
 	}
 }
 
-/* Pack and send  on event multicast ip adress a Sync message */
-static void issueSync(PtpClock *ptpClock)
+/* Pack and send  on event multicast ip adress, or to destination, a Sync message */
+static void issueSync(PtpClock *ptpClock, const ip_addr_t *destination)
 {
 	Timestamp originTimestamp;
 	TimeInternal internalTime;
@@ -1297,8 +1542,9 @@ static void issueSync(PtpClock *ptpClock)
 	getTime(&internalTime);
 	fromInternalTime(&internalTime, &originTimestamp);
 	msgPackSync(ptpClock, ptpClock->msgObuf, &originTimestamp);
+	msgPackUnicastFlag(ptpClock->msgObuf, destination != NULL);
 
-	if (!netSendEvent(&ptpClock->netPath, ptpClock->msgObuf, SYNC_LENGTH, &internalTime))
+	if (!netSendEvent(&ptpClock->netPath, ptpClock->msgObuf, SYNC_LENGTH, &internalTime, destination))
 	{
 		ERROR("issueSync: can't sent\n");
 		toState(ptpClock, PTP_FAULTY);
@@ -1313,7 +1559,7 @@ static void issueSync(PtpClock *ptpClock)
 		{
 			// waitingForLoopback = false;
 			addTime(&internalTime, &internalTime, &ptpClock->outboundLatency);
-			issueFollowup(ptpClock, &internalTime);
+			issueFollowup(ptpClock, &internalTime, destination);
 		}
 		else
 		{
@@ -1322,15 +1568,15 @@ static void issueSync(PtpClock *ptpClock)
 	}
 }
 
-/* Pack and send on general multicast ip adress a FollowUp message */
-static void issueFollowup(PtpClock *ptpClock, const TimeInternal *time)
+/* Pack and send on general multicast ip adress, or to destination, a FollowUp message */
+static void issueFollowup(PtpClock *ptpClock, const TimeInternal *time, const ip_addr_t *destination)
 {
 	Timestamp preciseOriginTimestamp;
 
 	fromInternalTime(time, &preciseOriginTimestamp);
 	msgPackFollowUp(ptpClock, ptpClock->msgObuf, &preciseOriginTimestamp);
 
-	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, FOLLOW_UP_LENGTH))
+	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, FOLLOW_UP_LENGTH, destination))
 	{
 		ERROR("issueFollowup: can't sent\n");
 		toState(ptpClock, PTP_FAULTY);
@@ -1342,18 +1588,188 @@ static void issueFollowup(PtpClock *ptpClock, const TimeInternal *time)
 }
 
 
-/* Pack and send on event multicast ip address a DelayReq message */
-static void issueDelayReq(PtpClock *ptpClock)
+/* The pair of the two-step Sync sequenceId, a new one replaces a stale or the oldest pair */
+static SyncPair *syncPairTake(PtpClock *ptpClock, int16_t sequenceId)
+{
+	SyncPair *pair = NULL;
+	uint32_t now = timerNow();
+	uint32_t timeout = SYNC_PAIR_TIMEOUT_INTERVALS * pow2ms(ptpClock->portDS.logSyncInterval);
+	int16_t i;
+
+	for (i = 0; i < SYNC_PAIR_ENTRIES; i++)
+	{
+		SyncPair *entry = &ptpClock->syncPairs[i];
+
+		if (!entry->sync && !entry->followUp) continue;
+
+		if (now - entry->received > timeout)
+		{
+			DBGV("syncPairTake: sequence %d timed out\n", (uint16_t) entry->sequenceId);
+			entry->sync = entry->followUp = FALSE;
+			continue;
+		}
+
+		if (entry->sequenceId == sequenceId) return entry;
+	}
+
+	for (i = 0; i < SYNC_PAIR_ENTRIES; i++)
+	{
+		SyncPair *entry = &ptpClock->syncPairs[i];
+
+		if (!entry->sync && !entry->followUp)
+		{
+			pair = entry;
+			break;
+		}
+
+		if (pair == NULL || now - entry->received > now - pair->received) pair = entry;
+	}
+
+	memset(pair, 0, sizeof(SyncPair));
+	pair->sequenceId = sequenceId;
+	pair->received = now;
+
+	return pair;
+}
+
+/* Give the servo the offset of a pair which has both halves, and free it */
+static void syncPairComplete(PtpClock *ptpClock, SyncPair *pair)
+{
+	if (!pair->sync || !pair->followUp) return;
+
+	pair->sync = pair->followUp = FALSE;
+
+	/* synchronize local clock */
+	updateOffset(ptpClock, &pair->syncReceipt, &pair->preciseOriginTimestamp, &pair->correctionField);
+	updateClock(ptpClock);
+
+	issueDelayReqTimerExpired(ptpClock);
+}
+
+/* Interval in usec between the Delay_Req of the startup burst, the fastest a master of this tree answers */
+static uint32_t delayReqBurstSpacing(const PtpClock *ptpClock)
+{
+	return max(pow2us(ptpClock->portDS.logMinDelayReqInterval - DELAYREQ_BURST_LOG_SPEEDUP), PTPD_TIMER_TICK_US);
+}
+
+/* End the startup burst once two successive path delays agree */
+static void delayReqBurstStable(PtpClock *ptpClock)
+{
+	int32_t delay = ptpClock->currentDS.meanPathDelay.nanoseconds;
+
+	if (ptpClock->delayReqBurst == 0) return;
+
+	if (ptpClock->owd_filt.n > 1 && abs(delay - ptpClock->burstDelay) < DELAYREQ_BURST_STABLE_NS)
+	{
+		DBGV("delayReqBurstStable: path delay %d nsec\n", delay);
+		ptpClock->delayReqBurst = 0;
+		timerStart(DELAYREQ_INTERVAL_TIMER, getRand(pow2us(ptpClock->portDS.logMinDelayReqInterval + 1)), ptpClock->itimer);
+		return;
+	}
+
+	ptpClock->burstDelay = delay;
+}
+
+/* A Sync of the parent, restart the watchdog at DEFAULT_SYNC_RECEIPT_TIMEOUT intervals of the master */
+static void syncReceived(PtpClock *ptpClock)
+{
+	int8_t logInterval = ptpClock->msgTmpHeader.logMessageInterval;
+	uint32_t now = timerNow();
+
+	if (logInterval < LOG_INTERVAL_MIN || logInterval > INTERVAL_LOG_MAX) logInterval = ptpClock->portDS.logSyncInterval;
+	timerStart(SYNC_RECEIPT_TIMER, DEFAULT_SYNC_RECEIPT_TIMEOUT * pow2us(logInterval), ptpClock->itimer);
+
+	if (ptpClock->failingOver)
+	{
+		ptpClock->failingOver = FALSE;
+		ptpClock->failoverMs = now - ptpClock->lastParentSync;
+		DBG("syncReceived: failover in %u ms\n", ptpClock->failoverMs);
+	}
+
+	if (ptpClock->holdover)
+	{
+		ptpClock->holdover = FALSE;
+		DBG("syncReceived: holdover left\n");
+	}
+
+	ptpClock->lastParentSync = now;
+}
+
+/* The parent sends no more Sync, fall back to the next best master or keep the frequency until one shows up */
+static void syncReceiptTimeout(PtpClock *ptpClock)
+{
+	int16_t i;
+
+	/* Its last Announce would make the BMC choose it again */
+	removeForeign(ptpClock, &ptpClock->parentDS.parentPortIdentity);
+
+	for (i = 0; i < ptpClock->foreignMasterDS.count; i++)
+	{
+		if (isQualifiedForeign(ptpClock, &ptpClock->foreignMasterDS.records[i])) break;
+	}
+
+	if (i < ptpClock->foreignMasterDS.count)
+	{
+		DBG("syncReceiptTimeout: parent silent, failing over\n");
+		ptpClock->failingOver = TRUE;
+
+#ifdef PTPD_BOUNDARY_CLOCK
+		/* The ports decide on Ebest together */
+		for (i = 0; i < NUMBER_PORTS; i++)
+		{
+			setFlag(ptpClock->ports[i].events, STATE_DECISION_EVENT);
+		}
+#else
+		setFlag(ptpClock->events, STATE_DECISION_EVENT);
+#endif
+		return;
+	}
+
+	/* The servo is not updated, the clock keeps the last frequency; the announce receipt timeout ends it */
+	ERROR("syncReceiptTimeout: parent silent, holdover\n");
+	ptpClock->holdover = TRUE;
+	timerStop(SYNC_RECEIPT_TIMER, ptpClock->itimer);
+}
+
+/* Remember the source address of the message of the parent, for the hybrid delay mode */
+static void learnParentAddr(PtpClock *ptpClock)
+{
+	ip_addr_copy(ptpClock->parentAddr, ptpClock->netPath.lastRecvAddr);
+	ptpClock->parentAddrIdentity = ptpClock->msgTmpHeader.sourcePortIdentity;
+	ptpClock->parentAddrKnown = TRUE;
+}
+
+/* The negotiated master, the parent in hybrid delay mode, else NULL for the multicast group */
+static const ip_addr_t *delayReqDestination(const PtpClock *ptpClock)
+{
+	const ip_addr_t *master = unicastMaster(ptpClock);
+
+	if (master != NULL) return master;
+
+	/* Until the new parent is heard, after a BMC change of parent, stay in multicast */
+	if (ptpClock->rtOpts->hybridDelay && ptpClock->netPath.transport != IEE_802_3 && ptpClock->parentAddrKnown &&
+			isSamePortIdentity(&ptpClock->parentAddrIdentity, &ptpClock->parentDS.parentPortIdentity))
+	{
+		return &ptpClock->parentAddr;
+	}
+
+	return NULL;
+}
+
+/* Pack and send on event multicast ip address, or to destination, a DelayReq message */
+static void issueDelayReq(PtpClock *ptpClock, const ip_addr_t *destination)
 {
 	Timestamp originTimestamp;
 	TimeInternal internalTime;
+	DelayReqSent *request;
 
 	getTime(&internalTime);
 	fromInternalTime(&internalTime, &originTimestamp);
 
 	msgPackDelayReq(ptpClock, ptpClock->msgObuf, &originTimestamp);
+	msgPackUnicastFlag(ptpClock->msgObuf, destination != NULL);
 
-	if (!netSendEvent(&ptpClock->netPath, ptpClock->msgObuf, DELAY_REQ_LENGTH, &internalTime))
+	if (!netSendEvent(&ptpClock->netPath, ptpClock->msgObuf, DELAY_REQ_LENGTH, &internalTime, destination))
 	{
 		ERROR("issueDelayReq: can't sent\n");
 		toState(ptpClock, PTP_FAULTY);
@@ -1361,14 +1777,22 @@ static void issueDelayReq(PtpClock *ptpClock)
 	else
 	{
 		DBGV("issueDelayReq\n");
-		ptpClock->sentDelayReqSequenceId++;
+
+		/* The request replaces the oldest one in flight */
+		request = &ptpClock->delayReqs[ptpClock->sentDelayReqSequenceId & DELAYREQ_INFLIGHT_MASK];
+		request->pending = FALSE;
 
 		/* Delay req TX timestamp is valid */
 		if (internalTime.seconds != 0)
 		{
 			addTime(&internalTime, &internalTime, &ptpClock->outboundLatency);
-			ptpClock->timestamp_delayReqSend = internalTime;
+			request->pending = TRUE;
+			request->sequenceId = ptpClock->sentDelayReqSequenceId;
+			request->sent = timerNow();
+			request->timestamp = internalTime;
 		}
+
+		ptpClock->sentDelayReqSequenceId++;
 	}
 }
 
@@ -1382,6 +1806,7 @@ static void issuePDelayReq(PtpClock *ptpClock)
 	fromInternalTime(&internalTime, &originTimestamp);
 
 	msgPackPDelayReq(ptpClock, ptpClock->msgObuf, &originTimestamp);
+	msgPackUnicastFlag(ptpClock->msgObuf, FALSE);
 
 	if (!netSendPeerEvent(&ptpClock->netPath, ptpClock->msgObuf, PDELAY_REQ_LENGTH, &internalTime))
 	{
@@ -1409,6 +1834,7 @@ static void issuePDelayResp(PtpClock *ptpClock, TimeInternal *time, const MsgHea
 
 	fromInternalTime(time, &requestReceiptTimestamp);
 	msgPackPDelayResp(ptpClock->msgObuf, pDelayReqHeader, &requestReceiptTimestamp);
+	msgPackUnicastFlag(ptpClock->msgObuf, FALSE);
 
 	if (!netSendPeerEvent(&ptpClock->netPath, ptpClock->msgObuf, PDELAY_RESP_LENGTH, time))
 	{
@@ -1428,22 +1854,106 @@ static void issuePDelayResp(PtpClock *ptpClock, TimeInternal *time, const MsgHea
 }
 
 
-/* Pack and send on event multicast ip adress a DelayResp message */
-static void issueDelayResp(PtpClock *ptpClock, const TimeInternal *time, const MsgHeader * delayReqHeader)
+/* Count the Delay_Req of the second of their receipt */
+static void delayReqCount(DelayRespEngine *engine, const TimeInternal *time)
+{
+	engine->stats.requests++;
+
+	if (time->seconds != engine->second)
+	{
+		engine->stats.requestsPerSecond = (time->seconds == engine->second + 1) ? engine->secondRequests : 0;
+		engine->second = time->seconds;
+		engine->secondRequests = 0;
+	}
+
+	engine->secondRequests++;
+}
+
+/* TRUE when the last answered Delay_Req of the entry is less than minMs old */
+static bool  delayReqWithin(const DelayReqRate *rate, const TimeInternal *time, int32_t minMs)
+{
+	TimeInternal elapsed;
+
+	subTime(&elapsed, time, &rate->last);
+
+	return (bool)(elapsed.seconds >= 0 && elapsed.seconds <= minMs / 1000 &&
+			elapsed.seconds * 1000 + elapsed.nanoseconds / 1000000 < minMs);
+}
+
+/* FALSE when the port asks faster than 2^DELAYRESP_RATE_SLACK times logMinDelayReqInterval */
+static bool  delayReqRateOk(PtpClock *ptpClock, const TimeInternal *time, const PortIdentity *portIdentity)
 {
+	DelayRespEngine *engine = &ptpClock->delayResp;
+	DelayReqRate *set, *rate = NULL, *oldest;
+	TimeInternal elapsed;
+	int32_t minMs;
+	int16_t i;
+
+	minMs = pow2ms(ptpClock->portDS.logMinDelayReqInterval - DELAYRESP_RATE_SLACK);
+
+	/* A port is only looked for in the ways of its set */
+	set = &engine->rates[(hashPortIdentity(portIdentity) % DELAYRESP_RATE_SETS) * DELAYRESP_RATE_WAYS];
+	oldest = &set[0];
+
+	for (i = 0; i < DELAYRESP_RATE_WAYS; i++)
+	{
+		if (isSamePortIdentity(&set[i].portIdentity, portIdentity))
+		{
+			rate = &set[i];
+			break;
+		}
+
+		subTime(&elapsed, &set[i].last, &oldest->last);
+		if (elapsed.seconds < 0 || (elapsed.seconds == 0 && elapsed.nanoseconds < 0)) oldest = &set[i];
+	}
+
+	if (rate == NULL)
+	{
+		/* A new slave replaces the least recently seen one of the set */
+		if (delayReqWithin(oldest, time, minMs)) engine->stats.rateEvictions++;
+		oldest->portIdentity = *portIdentity;
+		oldest->last = *time;
+		return TRUE;
+	}
+
+	if (delayReqWithin(rate, time, minMs)) return FALSE;
+
+	rate->last = *time;
+	return TRUE;
+}
+
+/* Patch the Delay_Resp template with the DelayReq and send it to the multicast group, or to destination */
+static void issueDelayResp(PtpClock *ptpClock, const TimeInternal *time, const MsgHeader * delayReqHeader, const ip_addr_t *destination)
+{
+	DelayRespEngine *engine = &ptpClock->delayResp;
 	Timestamp requestReceiptTimestamp;
 
+	delayReqCount(engine, time);
+
+	if (!delayReqRateOk(ptpClock, time, &delayReqHeader->sourcePortIdentity))
+	{
+		DBGV("issueDelayResp: port %d above its rate\n", delayReqHeader->sourcePortIdentity.portNumber);
+		engine->stats.rateDrops++;
+		return;
+	}
+
 	fromInternalTime(time, &requestReceiptTimestamp);
-	msgPackDelayResp(ptpClock, ptpClock->msgObuf, delayReqHeader, &requestReceiptTimestamp);
+	msgPackDelayRespFields(engine->buf, delayReqHeader, &requestReceiptTimestamp);
+	msgPackUnicastFlag(engine->buf, destination != NULL);
 
-	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, PDELAY_RESP_LENGTH))
+	/* A busy network only costs this slave its answer, the port stays master */
+	if (!netSendGeneral(&ptpClock->netPath, engine->buf, DELAY_RESP_LENGTH, destination))
 	{
 		ERROR("issueDelayResp: can't sent\n");
-		toState(ptpClock, PTP_FAULTY);
+		engine->stats.sendDrops++;
 	}
 	else
 	{
 		DBGV("issueDelayResp\n");
+		engine->stats.responses++;
+#ifdef PTPD_LOADGEN
+		loadgenResponse(delayReqHeader, time);
+#endif
 	}
 }
 
@@ -1453,6 +1963,7 @@ static void issuePDelayRespFollowUp(PtpClock *ptpClock, const TimeInternal *time
 	fromInternalTime(time, &responseOriginTimestamp);
 
 	msgPackPDelayRespFollowUp(ptpClock->msgObuf, pDelayReqHeader, &responseOriginTimestamp);
+	msgPackUnicastFlag(ptpClock->msgObuf, FALSE);
 
 	if (!netSendPeerGeneral(&ptpClock->netPath, ptpClock->msgObuf, PDELAY_RESP_FOLLOW_UP_LENGTH))
 	{
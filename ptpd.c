@@ -2,26 +2,81 @@
 
 #include "ptpd.h"
 
-// Statically allocated run-time configuration data.
-RunTimeOpts rtOpts;
-PtpClock ptpClock;
-ForeignMasterRecord ptpForeignRecords[DEFAULT_MAX_FOREIGN_RECORDS];
+// Statically allocated run-time configuration data, one set per instance.
+RunTimeOpts rtOpts[PTPD_NUMBER_INSTANCES];
+PtpClock ptpClock[PTPD_NUMBER_INSTANCES];
+ForeignMasterRecord ptpForeignRecords[PTPD_NUMBER_INSTANCES][PTPD_FOREIGN_RECORDS];
+#ifdef PTPD_TRANSPARENT_CLOCK
+TransparentClock transparentClock;
+#endif
 
 __IOuint32_t PTPTimer = 0;
 
 
 void ptpd_task(void)
 {
-	// Process the current state.
-	do
+	int16_t i;
+#ifdef PTPD_LOADGEN
+	TimeInternal busyStart, busyEnd;
+
+	// Feed the emulated Delay_Req before the instances handle their queues.
+	loadgenService();
+#endif
+
+	// Drain the auxiliary snapshot FIFO before it overflows.
+	snapshotService();
+
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
+	{
+		// Label and apply the PPS edges of the GNSS receiver.
+		if (rtOpts[i].gnss) gnssService(&ptpClock[i]);
+
+#ifdef PTPD_LOADGEN
+		getTime(&busyStart);
+#endif
+
+		// Process the current state.
+		do
+		{
+			// doState() has a switch for the actions and events to be
+			// checked for 'port_state'. The actions and events may or may not change
+			// 'port_state' by calling toState(), but once they are done we loop around
+			// again and perform the actions required for the new 'port_state'.
+			doState(&ptpClock[i]);
+		}
+		while (netSelect(&ptpClock[i].netPath, 0) > 0);
+
+#ifdef PTPD_LOADGEN
+		getTime(&busyEnd);
+		loadgenBusy(&ptpClock[i], &busyStart, &busyEnd);
+#endif
+	}
+}
+
+// Called every PTPD_TIMER_TICK_MS from the system tick.
+void ptpd_tick(void)
+{
+	int16_t i;
+
+	timerTick(PTPD_TIMER_TICK_MS);
+
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
+	{
+		timerUpdate(ptpClock[i].itimer, PTPD_TIMER_TICK_US);
+	}
+}
+
+void ptpd_shutdown(void)
+{
+	int16_t i;
+
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
 	{
-		// doState() has a switch for the actions and events to be
-		// checked for 'port_state'. The actions and events may or may not change
-		// 'port_state' by calling toState(), but once they are done we loop around
-		// again and perform the actions required for the new 'port_state'.
-		doState(&ptpClock);
+		ptpdShutdown(&ptpClock[i]);
 	}
-	while (netSelect(&ptpClock.netPath, 0) > 0);
+
+	// Stop the shared auxiliary inputs once no instance uses them.
+	snapshotShutdown();
 }
 
 void ptpd_alert(void)
@@ -31,35 +86,107 @@ void ptpd_alert(void)
 
 void ptpd_init(void)
 {
-	// Initialize run-time options to default values.
-	rtOpts.announceInterval = DEFAULT_ANNOUNCE_INTERVAL;
-	rtOpts.syncInterval = DEFAULT_SYNC_INTERVAL;
-	rtOpts.clockQuality.clockAccuracy = DEFAULT_CLOCK_ACCURACY;
-	rtOpts.clockQuality.clockClass = DEFAULT_CLOCK_CLASS;
-	rtOpts.clockQuality.offsetScaledLogVariance = DEFAULT_CLOCK_VARIANCE; /* 7.6.3.3 */
-	rtOpts.priority1 = DEFAULT_PRIORITY1;
-	rtOpts.priority2 = DEFAULT_PRIORITY2;
-	rtOpts.domainNumber = DEFAULT_DOMAIN_NUMBER;
-	rtOpts.slaveOnly = FALSE;
-	rtOpts.currentUtcOffset = DEFAULT_UTC_OFFSET;
-	rtOpts.servo.noResetClock = DEFAULT_NO_RESET_CLOCK;
-	rtOpts.servo.noAdjust = NO_ADJUST;
-	rtOpts.inboundLatency.nanoseconds = DEFAULT_INBOUND_LATENCY;
-	rtOpts.outboundLatency.nanoseconds = DEFAULT_OUTBOUND_LATENCY;
-	rtOpts.servo.sDelay = DEFAULT_DELAY_S;
-	rtOpts.servo.sOffset = DEFAULT_OFFSET_S;
-	rtOpts.servo.ap = DEFAULT_AP;
-	rtOpts.servo.ai = DEFAULT_AI;
-	rtOpts.maxForeignRecords = sizeof(ptpForeignRecords) / sizeof(ptpForeignRecords[0]);
-	rtOpts.stats = PTP_TEXT_STATS;
-	rtOpts.delayMechanism = DEFAULT_DELAY_MECHANISM;
-
-	// Initialize run time options.
-
-	if (ptpdStartup(&ptpClock, &rtOpts, ptpForeignRecords) != 0)
+	int16_t i;
+	uint8_t snapshotInputs = 0;
+
+	// Start the MAC system time once, all the instances share it.
+	ETH_PTPStart(ETH_PTP_FineUpdate);
+
+#ifdef PTPD_TRANSPARENT_CLOCK
+	tcInit(&transparentClock);
+#endif
+
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
+	{
+		// Initialize run-time options to default values.
+		rtOpts[i].announceInterval = DEFAULT_ANNOUNCE_INTERVAL;
+		rtOpts[i].syncInterval = DEFAULT_SYNC_INTERVAL;
+		rtOpts[i].clockQuality.clockAccuracy = DEFAULT_CLOCK_ACCURACY;
+		rtOpts[i].clockQuality.clockClass = DEFAULT_CLOCK_CLASS;
+		rtOpts[i].clockQuality.offsetScaledLogVariance = DEFAULT_CLOCK_VARIANCE; /* 7.6.3.3 */
+		rtOpts[i].priority1 = DEFAULT_PRIORITY1;
+		rtOpts[i].priority2 = DEFAULT_PRIORITY2;
+		rtOpts[i].slaveOnly = FALSE;
+		rtOpts[i].currentUtcOffset = DEFAULT_UTC_OFFSET;
+		rtOpts[i].servo.noResetClock = DEFAULT_NO_RESET_CLOCK;
+#ifdef PTPD_BOUNDARY_CLOCK
+		rtOpts[i].domainNumber = DEFAULT_DOMAIN_NUMBER; /* the ports of one clock share its domain */
+		rtOpts[i].servo.noAdjust = NO_ADJUST; /* whichever port is slave drives the clock */
+		rtOpts[i].portNumber = i + 1;
+		ptpClock[i].ports = ptpClock;
+#elif defined(PTPD_TRANSPARENT_CLOCK)
+		rtOpts[i].domainNumber = DEFAULT_DOMAIN_NUMBER;
+		rtOpts[i].servo.noAdjust = (i == 0) ? NO_ADJUST : TRUE; /* port 1 syntonizes the clock */
+		rtOpts[i].slaveOnly = TRUE; /* a transparent clock never originates Sync */
+		rtOpts[i].portNumber = i + 1;
+		ptpClock[i].ports = ptpClock;
+		ptpClock[i].tc = &transparentClock;
+#else
+		rtOpts[i].domainNumber = DEFAULT_DOMAIN_NUMBER + i; /* separate ordinary clocks */
+		rtOpts[i].servo.noAdjust = (i == 0) ? NO_ADJUST : TRUE; /* the MAC clock is shared */
+		rtOpts[i].portNumber = 1;
+		ptpClock[i].ports = &ptpClock[i];
+#endif
+		rtOpts[i].inboundLatency.nanoseconds = DEFAULT_INBOUND_LATENCY;
+		rtOpts[i].outboundLatency.nanoseconds = DEFAULT_OUTBOUND_LATENCY;
+		rtOpts[i].servo.sDelay = DEFAULT_DELAY_S;
+		rtOpts[i].servo.sOffset = DEFAULT_OFFSET_S;
+		rtOpts[i].servo.ap = DEFAULT_AP;
+		rtOpts[i].servo.ai = DEFAULT_AI;
+		rtOpts[i].maxForeignRecords = sizeof(ptpForeignRecords[i]) / sizeof(ptpForeignRecords[i][0]);
+		rtOpts[i].stats = PTP_TEXT_STATS;
+		rtOpts[i].delayMechanism = DEFAULT_DELAY_MECHANISM;
+		rtOpts[i].transport = DEFAULT_TRANSPORT;
+		rtOpts[i].ipv6Scope = DEFAULT_IPV6_SCOPE;
+		rtOpts[i].unicastNegotiation = DEFAULT_UNICAST_NEGOTIATION;
+		rtOpts[i].unicastGrantDuration = DEFAULT_UNICAST_GRANT_DURATION;
+		rtOpts[i].hybridDelay = DEFAULT_HYBRID_DELAY;
+		rtOpts[i].delayReqBurst = DEFAULT_DELAYREQ_BURST;
+		rtOpts[i].intervalRequests = DEFAULT_INTERVAL_REQUESTS;
+		rtOpts[i].hotStandby = DEFAULT_HOT_STANDBY;
+		rtOpts[i].ensemble = DEFAULT_ENSEMBLE;
+		rtOpts[i].syncIntervalAcquire = DEFAULT_SYNC_INTERVAL_ACQUIRE;
+		rtOpts[i].syncIntervalLocked = DEFAULT_SYNC_INTERVAL_LOCKED;
+		rtOpts[i].rxBudget = DEFAULT_RX_BUDGET;
+		rtOpts[i].ppsInterval = DEFAULT_PPS_INTERVAL_NS;
+		rtOpts[i].ppsWidth = DEFAULT_PPS_WIDTH_NS;
+		rtOpts[i].snapshotInputs = DEFAULT_SNAPSHOT_INPUTS;
+		rtOpts[i].currentUtcOffsetValid = DEFAULT_UTC_VALID;
+		rtOpts[i].timeTraceable = DEFAULT_TIME_TRACEABLE;
+		rtOpts[i].frequencyTraceable = DEFAULT_FREQUENCY_TRACEABLE;
+		rtOpts[i].ptpTimescale = (bool)(DEFAULT_TIMESCALE == PTP_TIMESCALE);
+		rtOpts[i].timeSource = DEFAULT_TIME_SOURCE;
+		rtOpts[i].gnss = DEFAULT_GNSS;
+		rtOpts[i].gnssPpsInput = DEFAULT_GNSS_PPS_INPUT;
+
+		// Initialize run time options.
+
+		if (ptpdStartup(&ptpClock[i], &rtOpts[i], ptpForeignRecords[i]) != 0)
+		{
+			printf("PTPD: startup failed");
+			return;
+		}
+
+		snapshotInputs |= rtOpts[i].snapshotInputs;
+	}
+
+	// The PPS output and the auxiliary inputs are shared by the instances too.
+	// Switch the PPS output to a programmable pulse train aligned to the second,
+	// as configured on the first instance which asks for one.
+	for (i = 0; i < PTPD_NUMBER_INSTANCES; i++)
 	{
-		printf("PTPD: startup failed");
-		return;
+		if (rtOpts[i].ppsInterval)
+		{
+			ppsStart(0, rtOpts[i].ppsInterval, rtOpts[i].ppsWidth, NULL);
+			break;
+		}
 	}
-}
 
+	// Timestamp external events in PTP time, on the inputs of all the instances.
+	if (snapshotInputs) snapshotInit(snapshotInputs);
+
+#ifdef PTPD_LOADGEN
+	// Emulated slaves load the first instance once it is master.
+	loadgenInit(&ptpClock[0], LOADGEN_SLAVES, LOADGEN_LOG_INTERVAL);
+#endif
+}
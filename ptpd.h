@@ -85,6 +85,11 @@ int32_t floorLog2(uint32_t);
  */
 uint8_t bmc(PtpClock*);
 
+/**
+ * \brief Compare the data sets of two foreign masters (9.3.4), negative when A is better
+ */
+int8_t bmcDataSetComparison(MsgHeader*, MsgAnnounce*, MsgHeader*, MsgAnnounce*, PtpClock*);
+
 /**
  * \brief When recommended state is Master, copy local data into parent and grandmaster dataset
  */
@@ -110,11 +115,167 @@ void initData(PtpClock*);
  */
 bool  isSamePortIdentity(const PortIdentity*, const PortIdentity*);
 
+/**
+ * \brief Hash of a port identity, for the tables indexed by port
+ */
+uint16_t hashPortIdentity(const PortIdentity*);
+
 /**
  * \brief Add foreign record defined by announce message
  */
 void addForeign(PtpClock*, const MsgHeader*, const MsgAnnounce*);
 
+/**
+ * \brief Remove the foreign record of a port, if any
+ */
+void removeForeign(PtpClock*, const PortIdentity*);
+
+/**
+ * \brief Forget all the foreign records
+ */
+void clearForeign(PtpClock*);
+
+/**
+ * \brief Remove the foreign records without Announce within the time window, oldest first
+ */
+void expireForeign(PtpClock*);
+
+/**
+ * \brief Check whether a foreign record has enough Announce within the time window (9.3.2.4.4)
+ */
+bool  isQualifiedForeign(const PtpClock*, const ForeignMasterRecord*);
+
+/**
+ * \brief Clear the residence time records of the transparent clock
+ */
+void tcInit(TransparentClock*);
+
+/**
+ * \brief Relay the received message to the other ports of the transparent clock
+ */
+void tcForward(PtpClock*, const TimeInternal*);
+
+/**
+ * \brief Reset the unicast grants, a slave asks its master at the next second
+ */
+void unicastInit(PtpClock*);
+
+/**
+ * \brief Expire the unicast grants and renew the requests, once a second
+ */
+void unicastService(PtpClock*);
+
+/**
+ * \brief Cancel the grants given by a port which stops being master
+ */
+void unicastRevoke(PtpClock*);
+
+/**
+ * \brief Cancel every grant given and received, before the network goes down
+ */
+void unicastShutdown(PtpClock*);
+
+/**
+ * \brief Answer the unicast negotiation TLVs of the received Signaling message
+ */
+void unicastSignaling(PtpClock*);
+
+/**
+ * \brief Find the grant of a message type given to a slave port
+ */
+UnicastGrant *unicastFindGrant(PtpClock*, const PortIdentity*, enum4bit_t);
+
+/**
+ * \brief Check whether a grant is due a message at this interval of the port
+ */
+bool  unicastGrantDue(UnicastGrant*, enum4bit_t, int8_t);
+
+/**
+ * \brief Address of the unicast master, NULL when not negotiating
+ */
+const ip_addr_t *unicastMaster(const PtpClock*);
+
+/**
+ * \brief Forget the requests of the slaves, back to the configured intervals
+ */
+void intervalReset(PtpClock*);
+
+/**
+ * \brief Ask the parent for a Sync interval
+ */
+void intervalRequest(PtpClock*, int8_t);
+
+/**
+ * \brief Follow the Sync interval of the parent, and ask again when it is not the one asked
+ */
+void intervalSync(PtpClock*);
+
+/**
+ * \brief Record the message interval request of a slave and apply the fastest one
+ */
+void intervalSignaling(PtpClock*, const MsgIntervalTLV*);
+
+/**
+ * \brief Expire the requests of the slaves which stopped asking
+ */
+void intervalService(PtpClock*);
+
+/**
+ * \brief The tracker measuring a foreign master, the standby or one of the ensemble, NULL for none
+ */
+MasterTracker *standbyFind(PtpClock*, const PortIdentity*);
+
+/**
+ * \brief Start measuring the master of a foreign record
+ */
+void standbyTrack(PtpClock*, MasterTracker*, const ForeignMasterRecord*);
+
+/**
+ * \brief Check whether a tracker has a recent offset and, in E2E, a path delay
+ */
+bool  standbyFresh(const PtpClock*, const MasterTracker*);
+
+/**
+ * \brief Track the second best foreign master, after a state decision
+ */
+void standbySelect(PtpClock*);
+
+/**
+ * \brief Measure the offset from the standby with its Sync
+ */
+void standbySync(PtpClock*, const TimeInternal*);
+
+/**
+ * \brief Complete the two-step Sync of the standby with its Follow_Up
+ */
+void standbyFollowUp(PtpClock*);
+
+/**
+ * \brief Measure the path delay to the standby with its answer to a Delay_Req of the slave
+ */
+void standbyDelayResp(PtpClock*, const DelayReqSent*);
+
+/**
+ * \brief Hand the filters of the standby over to the servo when it becomes the parent
+ * \return TRUE when the slave may stay calibrated
+ */
+bool  standbyHandover(PtpClock*);
+
+/**
+ * \brief Forget the masters of the ensemble
+ */
+void ensembleReset(PtpClock*);
+
+/**
+ * \brief Track the qualified foreign masters, after a state decision
+ */
+void ensembleSelect(PtpClock*);
+
+/**
+ * \brief Replace the filtered offset from the parent by the weighted mean of the agreeing masters
+ */
+void ensembleCombine(PtpClock*);
+
 /**
  * \brief Run PTP stack in current state
  */
@@ -130,6 +291,8 @@ void toState(PtpClock*, uint8_t);
 void ptpd_init(void);
 
 void ptpd_task(void);
+void ptpd_tick(void);
+void ptpd_shutdown(void);
 void ptpd_alert(void);
 
 #endif /* PTPD_H_*/
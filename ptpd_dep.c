@@ -1,4 +1,4 @@
-#include "ptpd_dep.h"
+#include "../ptpd.h"
 #include "stm32h7xx_hal_eth.h"
 
 
@@ -36,12 +36,12 @@
  +-----------+-----------+------------+
 */
 
-/* ´´Examples of subsecond increment and addend values using HCLK = 240 MHz*/
+/* ´´Examples of subsecond increment and addend values using HCLK = 240 MHz
 
  Addend * Increment = 2^63 / HCLK;
 
  ptp_tick = Increment * 10^9 / 2^31;
-
+*/
 
 #define ADJ_FREQ_BASE_ADDEND      0x35455A81
 #define ADJ_FREQ_BASE_INCREMENT   43
@@ -334,6 +334,70 @@ void ETH_PTPTimeStampCmd(FunctionalState NewState)
 	}
 }
 
+/**
+  * @brief  Enables or disables the time stamping of PTP over IEEE 802.3 frames.
+  * @param  NewState: new state of the snapshot for frames with ethertype 0x88F7
+  *   This parameter can be: ENABLE or DISABLE.
+  * @retval None
+  */
+void ETH_PTPTimeStampEthernetCmd(FunctionalState NewState)
+{
+	/* Check the parameters */
+	assert_param(IS_FUNCTIONAL_STATE(NewState));
+
+	if (NewState != DISABLE)
+	{
+		/* Take snapshots of PTPv2 messages carried directly in Ethernet frames */
+		ETH->MACTSCR |= ETH_MACTSCR_TSIPENA | ETH_MACTSCR_TSVER2ENA;
+	}
+	else
+	{
+		ETH->MACTSCR &= (~(uint32_t)ETH_MACTSCR_TSIPENA);
+	}
+}
+
+/**
+  * @brief  Enables or disables the time stamping of PTP over UDP/IPv6 frames.
+  * @param  NewState: new state of the snapshot for IPv6 frames
+  *   This parameter can be: ENABLE or DISABLE.
+  * @retval None
+  */
+void ETH_PTPTimeStampIPv6Cmd(FunctionalState NewState)
+{
+	/* Check the parameters */
+	assert_param(IS_FUNCTIONAL_STATE(NewState));
+
+	if (NewState != DISABLE)
+	{
+		ETH->MACTSCR |= ETH_MACTSCR_TSIPV6ENA;
+	}
+	else
+	{
+		ETH->MACTSCR &= (~(uint32_t)ETH_MACTSCR_TSIPV6ENA);
+	}
+}
+
+/**
+  * @brief  Enables or disables the reception of all multicast frames.
+  * @param  NewState: new state of the Pass All Multicast filter bit
+  *   This parameter can be: ENABLE or DISABLE.
+  * @retval None
+  */
+void ETH_PassAllMulticastCmd(FunctionalState NewState)
+{
+	/* Check the parameters */
+	assert_param(IS_FUNCTIONAL_STATE(NewState));
+
+	if (NewState != DISABLE)
+	{
+		ETH->MACPFR |= ETH_MACPFR_PM;
+	}
+	else
+	{
+		ETH->MACPFR &= (~(uint32_t)ETH_MACPFR_PM);
+	}
+}
+
 /**
   * @brief  Checks whether the specified ETHERNET PTP flag is set or not.
   * @param  ETH_PTP_FLAG: specifies the flag to check.
@@ -436,3 +500,174 @@ void ETH_PTPSetPPSFreq(uint8_t Freq)
 	ETH->MACPPSCR = Freq;
 }
 
+
+/**
+  * @brief  Enables or disables the flexible PPS output mode of a PPS channel.
+  * @param  Channel: specifies the PPS output channel.
+  * @param  NewState: new state of the flexible PPS mode.
+  *   This parameter can be: ENABLE or DISABLE.
+  * @retval None
+  */
+void ETH_PTPSetPPSFlexible(uint8_t Channel, FunctionalState NewState)
+{
+	/* Check the parameters */
+	assert_param(IS_ETH_PTP_PPS_CHANNEL(Channel));
+	assert_param(IS_FUNCTIONAL_STATE(NewState));
+
+	if (NewState != DISABLE)
+	{
+		/* PPSCTRL becomes PPSCMD, the target time only drives the PPS output */
+		ETH->MACPPSCR &= ~((ETH_MACPPSCR_PPSCTRL | ETH_MACPPSCR_TRGTMODSEL0) << (Channel * 8));
+		ETH->MACPPSCR |= (ETH_MACPPSCR_PPSEN0 | ETH_MACPPSCR_TRGTMODSEL0) << (Channel * 8);
+	}
+	else
+	{
+		/* Back to the fixed binary rollover PPS frequency */
+		ETH->MACPPSCR &= ~((ETH_MACPPSCR_PPSCTRL | ETH_MACPPSCR_PPSEN0 | ETH_MACPPSCR_TRGTMODSEL0) << (Channel * 8));
+	}
+}
+
+/**
+  * @brief  Sets the target time at which the next PPS command takes effect.
+  * @param  Channel: specifies the PPS output channel.
+  * @param  SecondValue: specifies the target time second value.
+  * @param  NanoSecondValue: specifies the target time nanosecond value.
+  * @retval None
+  */
+void ETH_PTPSetPPSTargetTime(uint8_t Channel, uint32_t SecondValue, uint32_t NanoSecondValue)
+{
+	__IO uint32_t *target;
+
+	/* Check the parameters */
+	assert_param(IS_ETH_PTP_PPS_CHANNEL(Channel));
+
+	/* Target time registers of the PPS channels are 16 bytes apart */
+	target = &ETH->MACPPSTTSR + (Channel * 4);
+
+	/* Wait until the previous target time has been consumed */
+	while (target[1] & ETH_MACPPSTTNR_TRGTBUSY0);
+
+	target[0] = SecondValue;
+	target[1] = ETH_PTPNanoSecond2SubSecond(NanoSecondValue) & ETH_MACPPSTTNR_TTSL0;
+}
+
+/**
+  * @brief  Sets the interval and the width of the flexible PPS pulse train.
+  * @param  Channel: specifies the PPS output channel.
+  * @param  IntervalNs: specifies the period of the pulse train in nanoseconds.
+  * @param  WidthNs: specifies the high time of one pulse in nanoseconds.
+  * @note   Both values are programmed in units of the subsecond increment.
+  * @retval None
+  */
+void ETH_PTPSetPPSInterval(uint8_t Channel, uint32_t IntervalNs, uint32_t WidthNs)
+{
+	__IO uint32_t *interval;
+	uint64_t ticks;
+	uint64_t widthTicks;
+
+	/* Check the parameters */
+	assert_param(IS_ETH_PTP_PPS_CHANNEL(Channel));
+
+	interval = &ETH->MACPPSIR + (Channel * 4);
+
+	/* ptp_tick = Increment * 10^9 / 2^31 */
+	ticks = ((uint64_t)IntervalNs << 31) / (1000000000ull * ADJ_FREQ_BASE_INCREMENT);
+	widthTicks = ((uint64_t)WidthNs << 31) / (1000000000ull * ADJ_FREQ_BASE_INCREMENT);
+
+	/* The registers hold the number of ticks minus one, the width must be shorter than the interval */
+	if (ticks < 2) ticks = 2;
+	if (widthTicks < 1) widthTicks = 1;
+	if (widthTicks >= ticks) widthTicks = ticks - 1;
+
+	interval[0] = (uint32_t)(ticks - 1);
+	interval[1] = (uint32_t)(widthTicks - 1);
+}
+
+/**
+  * @brief  Issues a command to the flexible PPS output.
+  * @param  Channel: specifies the PPS output channel.
+  * @param  Command: specifies the command, one of @ref ETH_PTP_PPS_commands.
+  * @retval None
+  */
+void ETH_PTPPPSCommand(uint8_t Channel, uint32_t Command)
+{
+	/* Check the parameters */
+	assert_param(IS_ETH_PTP_PPS_CHANNEL(Channel));
+	assert_param(IS_ETH_PTP_PPSCMD(Command));
+
+	/* PPSCMD clears itself once the previous command has been executed */
+	while (ETH->MACPPSCR & (ETH_MACPPSCR_PPSCTRL << (Channel * 8)));
+
+	ETH->MACPPSCR |= (Command & ETH_MACPPSCR_PPSCTRL) << (Channel * 8);
+}
+
+/**
+  * @brief  Enables the PTP time stamp interrupt (target time, seconds overflow
+  *         and auxiliary snapshot trigger).
+  * @param  None
+  * @retval None
+  */
+void ETH_EnablePTPTimeStampInterruptTrigger(void)
+{
+	ETH->MACIER |= ETH_MACIER_TSIE;
+}
+
+/**
+  * @brief  Enables or disables auxiliary snapshot inputs.
+  * @param  InputMask: specifies the auxiliary inputs (bit n for input n).
+  * @param  NewState: new state of the selected inputs.
+  *   This parameter can be: ENABLE or DISABLE.
+  * @retval None
+  */
+void ETH_PTPAuxSnapshotCmd(uint8_t InputMask, FunctionalState NewState)
+{
+	/* Check the parameters */
+	assert_param(IS_ETH_PTP_AUX_INPUT_MASK(InputMask));
+	assert_param(IS_FUNCTIONAL_STATE(NewState));
+
+	if (NewState != DISABLE)
+	{
+		ETH->MACACR |= ((uint32_t)InputMask * ETH_MACACR_ATSEN0);
+	}
+	else
+	{
+		ETH->MACACR &= ~((uint32_t)InputMask * ETH_MACACR_ATSEN0);
+	}
+}
+
+/**
+  * @brief  Flushes the auxiliary snapshot FIFO.
+  * @param  None
+  * @retval None
+  */
+void ETH_PTPAuxSnapshotFlush(void)
+{
+	ETH->MACACR |= ETH_MACACR_ATSFC;
+
+	/* The flush control bit clears itself once the FIFO is empty */
+	while (ETH->MACACR & ETH_MACACR_ATSFC);
+}
+
+/**
+  * @brief  Reads the time stamp status register.
+  * @note   Reading clears the AUXTSTRIG flag; ATSNS holds the number of pending
+  *         snapshots and ATSSTN the inputs of the oldest one.
+  * @param  None
+  * @retval The time stamp status register value.
+  */
+uint32_t ETH_PTPAuxSnapshotStatus(void)
+{
+	return ETH->MACTSSR;
+}
+
+/**
+  * @brief  Pops the oldest entry of the auxiliary snapshot FIFO.
+  * @param  timestamp: pointer to the snapshot time.
+  * @retval None
+  */
+void ETH_PTPAuxSnapshotGet(struct ptptime_t * timestamp)
+{
+	/* Nanoseconds first, reading the seconds register pops the FIFO */
+	timestamp->tv_nsec = ETH_PTPSubSecond2NanoSecond(ETH->MACATSNR);
+	timestamp->tv_sec = ETH->MACATSSR;
+}
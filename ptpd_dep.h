@@ -121,6 +121,35 @@ struct ptptime_t {
   */
 #define IS_PPS_FREQ(FREQUENCY) ((FREQUENCY) <= 0x0F)
 
+/** @defgroup ETH_PTP_PPS_commands
+  * @{
+  */
+#define ETH_PTP_PPSCMD_None             ((uint32_t)0x00000000)  /*!< No command */
+#define ETH_PTP_PPSCMD_StartSingle      ((uint32_t)0x00000001)  /*!< Start a single pulse at target time */
+#define ETH_PTP_PPSCMD_StartTrain       ((uint32_t)0x00000002)  /*!< Start a pulse train at target time */
+#define ETH_PTP_PPSCMD_CancelStart      ((uint32_t)0x00000003)  /*!< Cancel a pending start */
+#define ETH_PTP_PPSCMD_StopAtTime       ((uint32_t)0x00000004)  /*!< Stop the pulse train at target time */
+#define ETH_PTP_PPSCMD_StopImmediately  ((uint32_t)0x00000005)  /*!< Stop the pulse train immediately */
+#define ETH_PTP_PPSCMD_CancelStop       ((uint32_t)0x00000006)  /*!< Cancel a pending stop */
+#define IS_ETH_PTP_PPSCMD(CMD) ((CMD) <= ETH_PTP_PPSCMD_CancelStop)
+
+/**
+  * @}
+  */
+
+/**
+  * @brief  ETH PTP flexible PPS channels (the H743 MAC only routes PPS0 to a pin)
+  */
+#define ETH_PTP_PPS_CHANNELS      1
+#define IS_ETH_PTP_PPS_CHANNEL(CHANNEL) ((CHANNEL) < ETH_PTP_PPS_CHANNELS)
+
+/**
+  * @brief  ETH PTP auxiliary snapshot inputs
+  */
+#define ETH_PTP_AUX_INPUTS        4
+#define ETH_PTP_AUX_INPUTS_MASK   ((uint8_t)((1 << ETH_PTP_AUX_INPUTS) - 1))
+#define IS_ETH_PTP_AUX_INPUT_MASK(MASK) (((MASK) >> ETH_PTP_AUX_INPUTS) == 0)
+
 void ETH_PTPTime_SetTime(struct ptptime_t * timestamp);
 void ETH_PTPTime_GetTime(struct ptptime_t * timestamp);
 void ETH_PTPTime_UpdateOffset(struct ptptime_t * timeoffset);
@@ -131,8 +160,19 @@ void ETH_EnablePTPTimeStampInterruptTrigger(void);
 void ETH_EnablePTPTimeStampUpdate(void);
 void ETH_InitializePTPTimeStamp(void);
 void ETH_PTPSetPPSFreq(uint8_t Freq);
+void ETH_PTPSetPPSFlexible(uint8_t Channel, FunctionalState NewState);
+void ETH_PTPSetPPSTargetTime(uint8_t Channel, uint32_t SecondValue, uint32_t NanoSecondValue);
+void ETH_PTPSetPPSInterval(uint8_t Channel, uint32_t IntervalNs, uint32_t WidthNs);
+void ETH_PTPPPSCommand(uint8_t Channel, uint32_t Command);
+void ETH_PTPAuxSnapshotCmd(uint8_t InputMask, FunctionalState NewState);
+void ETH_PTPAuxSnapshotFlush(void);
+uint32_t ETH_PTPAuxSnapshotStatus(void);
+void ETH_PTPAuxSnapshotGet(struct ptptime_t * timestamp);
 void ETH_PTPUpdateMethodConfig(uint32_t UpdateMethod);
 void ETH_PTPTimeStampCmd(FunctionalState NewState);
+void ETH_PTPTimeStampEthernetCmd(FunctionalState NewState);
+void ETH_PTPTimeStampIPv6Cmd(FunctionalState NewState);
+void ETH_PassAllMulticastCmd(FunctionalState NewState);
 FlagStatus ETH_GetPTPFlagStatus(uint32_t ETH_PTP_FLAG);
 void ETH_SetPTPSubSecondIncrement(uint32_t SubSecondValue);
 void ETH_SetPTPTimeStampUpdate(uint32_t Sign, uint32_t SecondValue, uint32_t SubSecondValue);
@@ -193,11 +233,22 @@ void msgPackSync(const PtpClock*, octet_t*, const Timestamp*);
 void msgPackFollowUp(const PtpClock*, octet_t*, const Timestamp*);
 void msgPackDelayReq(const PtpClock*, octet_t*, const Timestamp*);
 void msgPackDelayResp(const PtpClock*, octet_t*, const MsgHeader*, const Timestamp*);
+void msgPackDelayRespTemplate(const PtpClock*, octet_t*);
+void msgPackDelayRespFields(octet_t*, const MsgHeader*, const Timestamp*);
 void msgPackPDelayReq(const PtpClock*, octet_t*, const Timestamp*);
 void msgPackPDelayResp(octet_t*, const MsgHeader*, const Timestamp*);
 void msgPackPDelayRespFollowUp(octet_t*, const MsgHeader*, const Timestamp*);
 int16_t msgPackManagement(const PtpClock*,  octet_t*, const MsgManagement*);
 int16_t msgPackManagementResponse(const PtpClock*,  octet_t*, MsgHeader*, const MsgManagement*);
+void msgAddCorrection(octet_t*, int64_t);
+void msgPackFollowUpFromSync(octet_t*, const octet_t*);
+void msgPackUnicastFlag(octet_t*, bool);
+void msgPackSignaling(const PtpClock*, octet_t*, const PortIdentity*);
+void msgUnpackSignaling(const octet_t*, MsgSignaling*);
+int16_t msgPackUnicastTLV(octet_t*, const MsgUnicastTLV*);
+int16_t msgUnpackUnicastTLV(const octet_t*, int16_t, int16_t, MsgUnicastTLV*);
+int16_t msgPackIntervalTLV(octet_t*, const MsgIntervalTLV*);
+bool  msgUnpackIntervalTLV(const octet_t*, int16_t, MsgIntervalTLV*);
 /** \}*/
 
 /** \name net.c (Linux API dependent)
@@ -209,10 +260,12 @@ bool  netShutdown(NetPath*);
 int32_t netSelect(NetPath*, const TimeInternal*);
 ssize_t netRecvEvent(NetPath*, octet_t*, TimeInternal*);
 ssize_t netRecvGeneral(NetPath*, octet_t*, TimeInternal*);
-ssize_t netSendEvent(NetPath*, const octet_t*, int16_t, TimeInternal*);
-ssize_t netSendGeneral(NetPath*, const octet_t*, int16_t);
+ssize_t netSendEvent(NetPath*, const octet_t*, int16_t, TimeInternal*, const ip_addr_t*);
+ssize_t netSendGeneral(NetPath*, const octet_t*, int16_t, const ip_addr_t*);
 ssize_t netSendPeerGeneral(NetPath*, const octet_t*, int16_t);
 ssize_t netSendPeerEvent(NetPath*, const octet_t*, int16_t, TimeInternal*);
+err_t netEthernetInput(struct pbuf*, struct netif*);
+bool  netInjectEvent(NetPath*, struct pbuf*);
 void netEmptyEventQ(NetPath *netPath);
 /** \}*/
 
@@ -225,6 +278,8 @@ void updatePeerDelay(PtpClock*, const TimeInternal*, bool);
 void updateDelay(PtpClock*, const TimeInternal*, const TimeInternal*, const TimeInternal*);
 void updateOffset(PtpClock *, const TimeInternal*, const TimeInternal*, const TimeInternal*);
 void updateClock(PtpClock*);
+void updateStandbyOffset(PtpClock*, MasterTracker*, const TimeInternal*, const TimeInternal*, const TimeInternal*);
+void updateStandbyDelay(MasterTracker*, const TimeInternal*, const TimeInternal*, const TimeInternal*);
 /** \}*/
 
 /** \name startup.c (Linux API dependent)
@@ -249,10 +304,53 @@ uint32_t getRand(uint32_t);
 /** \name timer.c (Linux API dependent)
  * -Handle with timers */
 /**\{*/
-void initTimer(void);
-void timerStop(int32_t);
-void timerStart(int32_t,  uint32_t);
-bool timerExpired(int32_t);
+void initTimer(IntervalTimer*);
+void timerUpdate(IntervalTimer*, uint32_t);
+void timerTick(uint32_t);
+uint32_t timerNow(void);
+void timerStop(int32_t, IntervalTimer*);
+void timerStart(int32_t,  uint32_t, IntervalTimer*);
+bool timerExpired(int32_t, IntervalTimer*);
+/** \}*/
+
+/** \name pps.c
+ * -Flexible PPS output */
+/**\{*/
+bool ppsStart(uint8_t, uint32_t, uint32_t, const TimeInternal*);
+bool ppsStartGroup(uint8_t, uint32_t, uint32_t, const TimeInternal*);
+bool ppsSquareWave(uint8_t, uint32_t);
+void ppsStop(uint8_t);
+void ppsRealign(void);
+/** \}*/
+
+/** \name snapshot.c
+ * -Auxiliary snapshot input timestamping */
+/**\{*/
+void snapshotInit(uint8_t);
+void snapshotShutdown(void);
+void snapshotService(void);
+void snapshotClaim(uint8_t);
+bool snapshotGet(SnapshotEvent*);
+bool snapshotTake(uint8_t, SnapshotEvent*);
+void snapshotGetStats(SnapshotStats*);
+/** \}*/
+
+/** \name loadgen.c
+ * -Emulated slaves to measure the capacity of a master (PTPD_LOADGEN) */
+/**\{*/
+void loadgenInit(PtpClock*, uint16_t, int8_t);
+void loadgenService(void);
+void loadgenResponse(const MsgHeader*, const TimeInternal*);
+void loadgenBusy(const PtpClock*, const TimeInternal*, const TimeInternal*);
+void loadgenGetStats(LoadGenStats*);
+/** \}*/
+
+/** \name gnss.c
+ * -Discipline the clock from a GNSS receiver (PPS + NMEA) */
+/**\{*/
+void gnssInit(PtpClock*);
+void gnssInput(PtpClock*, const octet_t*, int16_t);
+void gnssService(PtpClock*);
 /** \}*/
 
 
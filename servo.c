@@ -25,7 +25,8 @@ void initClock(PtpClock *ptpClock)
 		ptpClock->offsetHistory[1] = 0;
 	}
 
-	ptpClock->waitingForFollowUp = FALSE;
+	memset(ptpClock->syncPairs, 0, sizeof(ptpClock->syncPairs));
+	memset(ptpClock->delayReqs, 0, sizeof(ptpClock->delayReqs));
 
 	ptpClock->waitingForPDelayRespFollowUp = FALSE;
 
@@ -126,10 +127,21 @@ static void filter(int32_t * nsec_current, Filter * filt)
 	*nsec_current = filt->y_prev;
 }
 
+/* Filtered distance of the offsets from their filtered mean */
+static void updateDeviation(int32_t offset, int32_t mean, Filter *filt, int32_t *deviation)
+{
+	int32_t sample = abs(offset - mean);
+
+	filter(&sample, filt);
+	*deviation = sample;
+}
+
 /* 11.2 */
 void updateOffset(PtpClock *ptpClock, const TimeInternal *syncEventIngressTimestamp,
 									const TimeInternal *preciseOriginTimestamp, const TimeInternal *correctionField)
 {
+	int32_t offset;
+
 	DBGV("updateOffset\n");
 
 	/*  <offsetFromMaster> = <syncEventIngressTimestamp> - <preciseOriginTimestamp>
@@ -169,8 +181,16 @@ void updateOffset(PtpClock *ptpClock, const TimeInternal *syncEventIngressTimest
 	}
 
 	/* Filter offsetFromMaster */
+	offset = ptpClock->currentDS.offsetFromMaster.nanoseconds;
 	filter(&ptpClock->currentDS.offsetFromMaster.nanoseconds, &ptpClock->ofm_filt);
 
+	/* Steer to the weighted mean of all the masters */
+	if (ptpClock->rtOpts->ensemble)
+	{
+		updateDeviation(offset, ptpClock->currentDS.offsetFromMaster.nanoseconds, &ptpClock->ensemble.dev_filt, &ptpClock->ensemble.parentDeviation);
+		ensembleCombine(ptpClock);
+	}
+
 	/* Check results */
 	if (abs(ptpClock->currentDS.offsetFromMaster.nanoseconds) < DEFAULT_CALIBRATED_OFFSET_NS)
 	{
@@ -215,6 +235,72 @@ void updateDelay(PtpClock * ptpClock, const TimeInternal *delayEventEgressTimest
 	}
 }
 
+/* Offset from a tracked master, as updateOffset but with the path delay of that master */
+void updateStandbyOffset(PtpClock *ptpClock, MasterTracker *standby, const TimeInternal *syncEventIngressTimestamp,
+									const TimeInternal *preciseOriginTimestamp, const TimeInternal *correctionField)
+{
+	int32_t offset;
+
+	subTime(&standby->Tms, syncEventIngressTimestamp, preciseOriginTimestamp);
+	subTime(&standby->Tms, &standby->Tms, correctionField);
+
+	switch (ptpClock->portDS.delayMechanism)
+	{
+		case E2E:
+				subTime(&standby->offsetFromMaster, &standby->Tms, &standby->meanPathDelay);
+				break;
+
+		case P2P:
+				/* Same link, same peer delay as the parent */
+				subTime(&standby->offsetFromMaster, &standby->Tms, &ptpClock->portDS.peerMeanPathDelay);
+				break;
+
+		default:
+				standby->offsetFromMaster = standby->Tms;
+				break;
+	}
+
+	if (standby->offsetFromMaster.seconds != 0)
+	{
+		DBGV("updateStandbyOffset: cannot filter seconds\n");
+		standby->ofm_filt.n = 0;
+		standby->dev_filt.n = 0;
+		return;
+	}
+
+	offset = standby->offsetFromMaster.nanoseconds;
+	filter(&standby->offsetFromMaster.nanoseconds, &standby->ofm_filt);
+	updateDeviation(offset, standby->offsetFromMaster.nanoseconds, &standby->dev_filt, &standby->deviation);
+}
+
+/* Path delay to a tracked master, as updateDelay */
+void updateStandbyDelay(MasterTracker *standby, const TimeInternal *delayEventEgressTimestamp,
+								 const TimeInternal *recieveTimestamp, const TimeInternal *correctionField)
+{
+	TimeInternal Tsm;
+
+	/* Tms valid ? */
+	if (0 == standby->ofm_filt.n)
+	{
+		DBGV("updateStandbyDelay: Tms is not valid");
+		return;
+	}
+
+	subTime(&Tsm, recieveTimestamp, delayEventEgressTimestamp);
+	subTime(&Tsm, &Tsm, correctionField);
+	addTime(&standby->meanPathDelay, &standby->Tms, &Tsm);
+	div2Time(&standby->meanPathDelay);
+
+	if (0 != standby->meanPathDelay.seconds)
+	{
+		DBGV("updateStandbyDelay: cannot filter with seconds");
+	}
+	else
+	{
+		filter(&standby->meanPathDelay.nanoseconds, &standby->owd_filt);
+	}
+}
+
 void updatePeerDelay(PtpClock *ptpClock, const TimeInternal *correctionField, bool  twoStep)
 {
 	DBGV("updatePeerDelay\n");
@@ -250,7 +336,8 @@ void updateClock(PtpClock *ptpClock)
 {
 	int32_t adj;
 	TimeInternal timeTmp;
-	int32_t offsetNorm;
+	int64_t offsetNorm;
+	int64_t drift;
 
 	DBGV("updateClock\n");
 
@@ -279,26 +366,29 @@ void updateClock(PtpClock *ptpClock)
 
 		/* normalize offset to 1s sync interval -> response of the servo will
 		 * be same for all sync interval values, but faster/slower
-		 * (possible lost of precision/overflow but much more stable) */
+		 * (possible lost of precision but much more stable), 64 bits as
+		 * 100 ms << 8 at the shortest interval does not fit in 32 */
 		offsetNorm = ptpClock->currentDS.offsetFromMaster.nanoseconds;
 		if (ptpClock->portDS.logSyncInterval > 0)
 			offsetNorm >>= ptpClock->portDS.logSyncInterval;
 		else if (ptpClock->portDS.logSyncInterval < 0)
-			offsetNorm <<= -ptpClock->portDS.logSyncInterval;
+			offsetNorm *= 1 << -ptpClock->portDS.logSyncInterval;
 
 		/* the accumulator for the I component */
-		ptpClock->observedDrift += offsetNorm / ptpClock->servo.ai;
+		drift = ptpClock->observedDrift + offsetNorm / ptpClock->servo.ai;
 
 		/* clamp the accumulator to ADJ_FREQ_MAX for sanity */
-		if (ptpClock->observedDrift > ADJ_FREQ_MAX)
-			ptpClock->observedDrift = ADJ_FREQ_MAX;
-		else if (ptpClock->observedDrift < -ADJ_FREQ_MAX)
-			ptpClock->observedDrift = -ADJ_FREQ_MAX;
+		if (drift > ADJ_FREQ_MAX)
+			drift = ADJ_FREQ_MAX;
+		else if (drift < -ADJ_FREQ_MAX)
+			drift = -ADJ_FREQ_MAX;
+		ptpClock->observedDrift = (int32_t) drift;
 
 		/* apply controller output as a clock tick rate adjustment */
 		if (!ptpClock->servo.noAdjust)
 		{
-			adj = offsetNorm / ptpClock->servo.ap + ptpClock->observedDrift;
+			offsetNorm = offsetNorm / ptpClock->servo.ap + ptpClock->observedDrift;
+			adj = (int32_t) max(min(offsetNorm, INT32_MAX), -INT32_MAX);
 			adjFreq(-adj);
 		}
 
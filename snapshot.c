@@ -0,0 +1,154 @@
+/* snapshot.c */
+
+#include "../ptpd.h"
+#include "stm32h7xx_hal_eth.h"
+
+/* Single producer (snapshotService, PTP task) / single consumer (snapshotGet)
+ * event FIFO. Each side only writes its own index, so no locking is needed;
+ * the barriers order the entry against the index for a consumer running in
+ * another task. */
+static volatile SnapshotEvent snapshotQueue[SNAPSHOT_QUEUE_SIZE];
+static volatile uint16_t snapshotHead;
+static volatile uint16_t snapshotTail;
+static volatile SnapshotStats snapshotStats;
+
+/* Claimed inputs bypass the FIFO, the newest event of each one waits for
+ * snapshotTake; the GNSS PPS this way never competes with the application. */
+static volatile SnapshotEvent snapshotLatest[ETH_PTP_AUX_INPUTS];
+static volatile uint8_t snapshotClaimed;
+static volatile uint8_t snapshotPending;
+
+/* Enable timestamping of the auxiliary inputs in inputMask */
+void snapshotInit(uint8_t inputMask)
+{
+	DBG("snapshotInit: inputs 0x%x\n", inputMask);
+
+	ETH_PTPAuxSnapshotCmd(ETH_PTP_AUX_INPUTS_MASK, DISABLE);
+	ETH_PTPAuxSnapshotFlush();
+
+	snapshotHead = 0;
+	snapshotTail = 0;
+	snapshotPending = 0;
+	memset((void *) &snapshotStats, 0, sizeof(snapshotStats));
+
+	ETH_PTPAuxSnapshotCmd(inputMask, ENABLE);
+}
+
+void snapshotShutdown(void)
+{
+	ETH_PTPAuxSnapshotCmd(ETH_PTP_AUX_INPUTS_MASK, DISABLE);
+	ETH_PTPAuxSnapshotFlush();
+	snapshotClaimed = 0;
+	snapshotPending = 0;
+}
+
+/* Deliver the events of input to snapshotTake instead of the FIFO */
+void snapshotClaim(uint8_t input)
+{
+	if (input >= ETH_PTP_AUX_INPUTS)
+	{
+		ERROR("snapshotClaim: invalid input %d\n", input);
+		return;
+	}
+
+	snapshotClaimed |= 1 << input;
+}
+
+/* Hand an event to the inputs which claimed it, and to the FIFO for the others */
+static void snapshotPut(const SnapshotEvent *event)
+{
+	uint8_t claimed = event->inputs & snapshotClaimed;
+	uint16_t head;
+	uint8_t i;
+
+	for (i = 0; i < ETH_PTP_AUX_INPUTS; i++)
+	{
+		if (claimed & (1 << i)) snapshotLatest[i] = *event;
+	}
+
+	snapshotPending |= claimed;
+	snapshotStats.events++;
+
+	if ((event->inputs & ~claimed) == 0) return;
+
+	head = (snapshotHead + 1) & SNAPSHOT_QUEUE_MASK;
+	if (head == snapshotTail)
+	{
+		/* Consumer is too slow, drop the newest event */
+		snapshotStats.overflows++;
+		return;
+	}
+
+	snapshotQueue[head] = *event;
+
+	/* Publish the entry only once it is complete */
+	__DMB();
+	snapshotHead = head;
+}
+
+/* Move the MAC auxiliary timestamp FIFO into the event FIFO, called from the PTP task */
+void snapshotService(void)
+{
+	struct ptptime_t timestamp;
+	SnapshotEvent event;
+	uint32_t status;
+	uint8_t pending;
+
+	status = ETH_PTPAuxSnapshotStatus();
+
+	if (status & ETH_MACTSSR_ATSSTM)
+	{
+		/* The MAC FIFO overflowed, at least one trigger was lost */
+		snapshotStats.missed++;
+	}
+
+	for (pending = (status & ETH_MACTSSR_ATSNS) >> ETH_MACTSSR_ATSNS_Pos; pending > 0; pending--)
+	{
+		ETH_PTPAuxSnapshotGet(&timestamp);
+
+		event.time.seconds = timestamp.tv_sec;
+		event.time.nanoseconds = timestamp.tv_nsec;
+		event.inputs = (status & ETH_MACTSSR_ATSSTN) >> ETH_MACTSSR_ATSSTN_Pos;
+		snapshotPut(&event);
+
+		/* The trigger identifier refers to the new FIFO head */
+		status = ETH_PTPAuxSnapshotStatus();
+	}
+}
+
+/* Get the newest event of a claimed input not taken yet, from the PTP task only */
+bool snapshotTake(uint8_t input, SnapshotEvent *event)
+{
+	if (input >= ETH_PTP_AUX_INPUTS || !(snapshotPending & (1 << input))) return FALSE;
+
+	*event = snapshotLatest[input];
+	snapshotPending &= ~(1 << input);
+
+	return TRUE;
+}
+
+/* Get the oldest external event, returns FALSE if there is none */
+bool snapshotGet(SnapshotEvent *event)
+{
+	uint16_t tail;
+
+	if (snapshotTail == snapshotHead) return FALSE;
+
+	/* Read the entry only after the head which published it */
+	__DMB();
+	tail = (snapshotTail + 1) & SNAPSHOT_QUEUE_MASK;
+	*event = snapshotQueue[tail];
+
+	/* and release the slot only once it is read */
+	__DMB();
+	snapshotTail = tail;
+
+	return TRUE;
+}
+
+void snapshotGetStats(SnapshotStats *stats)
+{
+	stats->events = snapshotStats.events;
+	stats->missed = snapshotStats.missed;
+	stats->overflows = snapshotStats.overflows;
+}
@@ -0,0 +1,202 @@
+/* standby.c */
+
+#include "ptpd.h"
+
+/* Hot standby. A slave measures the offset and the path delay of the second
+ * best master of its foreign records with the Sync and Follow_Up that the
+ * slave otherwise ignores, and with the answers of that master to the
+ * multicast Delay_Req of the slave. When the BMC makes the standby the parent,
+ * its filters go to the servo, which stays locked and slews over the phase
+ * difference of the two masters instead of starting again from UNCALIBRATED.
+ * The masters of an ensemble are measured the same way, and handed over the
+ * same way when one of them becomes the parent. */
+
+MasterTracker *standbyFind(PtpClock *ptpClock, const PortIdentity *portIdentity)
+{
+	int16_t i;
+
+	if (ptpClock->standby.active && isSamePortIdentity(&ptpClock->standby.portIdentity, portIdentity)) return &ptpClock->standby;
+
+	for (i = 0; i < ENSEMBLE_MASTERS; i++)
+	{
+		if (ptpClock->ensemble.masters[i].active && isSamePortIdentity(&ptpClock->ensemble.masters[i].portIdentity, portIdentity))
+		{
+			return &ptpClock->ensemble.masters[i];
+		}
+	}
+
+	return NULL;
+}
+
+void standbyTrack(PtpClock *ptpClock, MasterTracker *standby, const ForeignMasterRecord *record)
+{
+	memset(standby, 0, sizeof(MasterTracker));
+	standby->active = TRUE;
+	standby->portIdentity = record->foreignMasterPortIdentity;
+	standby->stepsRemoved = record->announce.stepsRemoved + 1;
+	standby->logSyncInterval = ptpClock->portDS.logSyncInterval;
+	standby->ofm_filt.s = ptpClock->servo.sOffset;
+	standby->owd_filt.s = ptpClock->servo.sDelay;
+	standby->dev_filt.s = ptpClock->servo.sOffset;
+}
+
+bool standbyFresh(const PtpClock *ptpClock, const MasterTracker *standby)
+{
+	if (standby->ofm_filt.n == 0 || timerNow() - standby->lastSync > DEFAULT_SYNC_RECEIPT_TIMEOUT * pow2ms(standby->logSyncInterval)) return FALSE;
+
+	/* Without its path delay the offset is off by that delay */
+	return (bool)(ptpClock->portDS.delayMechanism != E2E || standby->owd_filt.n > 0);
+}
+
+void standbySelect(PtpClock *ptpClock)
+{
+	MasterTracker *standby = &ptpClock->standby;
+	ForeignMasterRecord *records = ptpClock->foreignMasterDS.records;
+	int16_t i, best = -1;
+
+	for (i = 0; i < ptpClock->foreignMasterDS.count; i++)
+	{
+		if (!isQualifiedForeign(ptpClock, &records[i]) ||
+				isSamePortIdentity(&records[i].foreignMasterPortIdentity, &ptpClock->parentDS.parentPortIdentity)) continue;
+
+		if (best < 0 || bmcDataSetComparison(&records[i].header, &records[i].announce,
+				&records[best].header, &records[best].announce, ptpClock) > 0)
+		{
+			best = i;
+		}
+	}
+
+	if (best < 0)
+	{
+		standby->active = FALSE;
+		return;
+	}
+
+	if (standby->active && isSamePortIdentity(&standby->portIdentity, &records[best].foreignMasterPortIdentity)) return;
+
+	standbyTrack(ptpClock, standby, &records[best]);
+	DBG("standbySelect: tracking record %d\n", best);
+}
+
+void standbySync(PtpClock *ptpClock, const TimeInternal *time)
+{
+	MasterTracker *standby = standbyFind(ptpClock, &ptpClock->msgTmpHeader.sourcePortIdentity);
+	TimeInternal originTimestamp;
+	TimeInternal correctionField;
+	int8_t logInterval = ptpClock->msgTmpHeader.logMessageInterval;
+
+	if (standby == NULL) return;
+
+	if (logInterval >= LOG_INTERVAL_MIN && logInterval <= INTERVAL_LOG_MAX) standby->logSyncInterval = logInterval;
+	standby->lastSync = timerNow();
+	scaledNanosecondsToInternalTime(&ptpClock->msgTmpHeader.correctionfield, &correctionField);
+
+	if (!getFlag(ptpClock->msgTmpHeader.flagField[0], FLAG0_TWO_STEP))
+	{
+		msgUnpackSync(ptpClock->msgIbuf, &ptpClock->msgTmp.sync);
+		toInternalTime(&originTimestamp, &ptpClock->msgTmp.sync.originTimestamp);
+		updateStandbyOffset(ptpClock, standby, time, &originTimestamp, &correctionField);
+		return;
+	}
+
+	/* One pair is enough, the Follow_Up of the standby may come first too */
+	if (standby->pair.sequenceId != ptpClock->msgTmpHeader.sequenceId || standby->pair.sync)
+	{
+		memset(&standby->pair, 0, sizeof(SyncPair));
+		standby->pair.sequenceId = ptpClock->msgTmpHeader.sequenceId;
+	}
+
+	standby->pair.sync = TRUE;
+	standby->pair.syncReceipt = *time;
+	addTime(&standby->pair.correctionField, &standby->pair.correctionField, &correctionField);
+
+	if (standby->pair.followUp)
+	{
+		standby->pair.sync = standby->pair.followUp = FALSE;
+		updateStandbyOffset(ptpClock, standby, &standby->pair.syncReceipt, &standby->pair.preciseOriginTimestamp, &standby->pair.correctionField);
+	}
+}
+
+void standbyFollowUp(PtpClock *ptpClock)
+{
+	MasterTracker *standby = standbyFind(ptpClock, &ptpClock->msgTmpHeader.sourcePortIdentity);
+	TimeInternal correctionField;
+
+	if (standby == NULL) return;
+
+	if (standby->pair.sequenceId != ptpClock->msgTmpHeader.sequenceId || standby->pair.followUp)
+	{
+		memset(&standby->pair, 0, sizeof(SyncPair));
+		standby->pair.sequenceId = ptpClock->msgTmpHeader.sequenceId;
+	}
+
+	msgUnpackFollowUp(ptpClock->msgIbuf, &ptpClock->msgTmp.follow);
+	standby->pair.followUp = TRUE;
+	toInternalTime(&standby->pair.preciseOriginTimestamp, &ptpClock->msgTmp.follow.preciseOriginTimestamp);
+	scaledNanosecondsToInternalTime(&ptpClock->msgTmpHeader.correctionfield, &correctionField);
+	addTime(&standby->pair.correctionField, &standby->pair.correctionField, &correctionField);
+
+	if (standby->pair.sync)
+	{
+		standby->pair.sync = standby->pair.followUp = FALSE;
+		updateStandbyOffset(ptpClock, standby, &standby->pair.syncReceipt, &standby->pair.preciseOriginTimestamp, &standby->pair.correctionField);
+	}
+}
+
+void standbyDelayResp(PtpClock *ptpClock, const DelayReqSent *request)
+{
+	MasterTracker *standby = standbyFind(ptpClock, &ptpClock->msgTmpHeader.sourcePortIdentity);
+	TimeInternal receiveTimestamp;
+	TimeInternal correctionField;
+
+	if (standby == NULL) return;
+
+	/* The answer of the parent may already have cleared pending, the transmit timestamp stays */
+	if (request->sequenceId != ptpClock->msgTmpHeader.sequenceId ||
+			timerNow() - request->sent > DELAYREQ_TIMEOUT_INTERVALS * pow2ms(ptpClock->portDS.logMinDelayReqInterval + 1))
+	{
+		DBGV("standbyDelayResp: doesn't match with the delayReq\n");
+		return;
+	}
+
+	toInternalTime(&receiveTimestamp, &ptpClock->msgTmp.resp.receiveTimestamp);
+	scaledNanosecondsToInternalTime(&ptpClock->msgTmpHeader.correctionfield, &correctionField);
+	updateStandbyDelay(standby, &request->timestamp, &receiveTimestamp, &correctionField);
+}
+
+bool standbyHandover(PtpClock *ptpClock)
+{
+	MasterTracker *standby = standbyFind(ptpClock, &ptpClock->parentDS.parentPortIdentity);
+
+	if (standby == NULL) return FALSE;
+
+	standby->active = FALSE;
+
+	/* Cold when the standby was not measured lately, or its path delay is unknown */
+	if (!standbyFresh(ptpClock, standby))
+	{
+		DBG("standbyHandover: standby not measured, calibrating\n");
+		return FALSE;
+	}
+
+	/* Halves of the old parent would pair with the sequenceId of the new one */
+	memset(ptpClock->syncPairs, 0, sizeof(ptpClock->syncPairs));
+
+	ptpClock->Tms = standby->Tms;
+	ptpClock->currentDS.offsetFromMaster = standby->offsetFromMaster;
+	ptpClock->ofm_filt = standby->ofm_filt;
+	ptpClock->ensemble.dev_filt = standby->dev_filt;
+	ptpClock->ensemble.parentDeviation = standby->deviation;
+
+	if (ptpClock->portDS.delayMechanism == E2E)
+	{
+		ptpClock->currentDS.meanPathDelay = standby->meanPathDelay;
+		ptpClock->owd_filt = standby->owd_filt;
+		ptpClock->delayReqBurst = 0;
+	}
+
+	DBG("standbyHandover: offset %d nsec, delay %d nsec\n",
+			standby->offsetFromMaster.nanoseconds, standby->meanPathDelay.nanoseconds);
+
+	return (bool)(abs(standby->offsetFromMaster.nanoseconds) < DEFAULT_CALIBRATED_OFFSET_NS);
+}
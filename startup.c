@@ -4,6 +4,7 @@
 
 void ptpdShutdown(PtpClock *ptpClock)
 {
+	unicastShutdown(ptpClock);
 	netShutdown(&ptpClock->netPath);
 }
 
@@ -15,13 +16,32 @@ int16_t ptpdStartup(PtpClock * ptpClock, RunTimeOpts *rtOpts, ForeignMasterRecor
 	/* 9.2.2 */
 	if (rtOpts->slaveOnly) rtOpts->clockQuality.clockClass = DEFAULT_CLOCK_CLASS_SLAVE_ONLY;
 
+	/* The interval timers and the servo normalization stop at 2^LOG_INTERVAL_MIN */
+	if (rtOpts->syncInterval < LOG_INTERVAL_MIN)
+	{
+		ERROR("ptpdStartup: sync interval 2^%d below 2^%d\n", rtOpts->syncInterval, LOG_INTERVAL_MIN);
+		rtOpts->syncInterval = LOG_INTERVAL_MIN;
+	}
+
+	if (rtOpts->announceInterval < LOG_INTERVAL_MIN)
+	{
+		ERROR("ptpdStartup: announce interval 2^%d below 2^%d\n", rtOpts->announceInterval, LOG_INTERVAL_MIN);
+		rtOpts->announceInterval = LOG_INTERVAL_MIN;
+	}
+
 	/* No negative or zero attenuation */
 	if (rtOpts->servo.ap < 1) rtOpts->servo.ap = 1;
 	if (rtOpts->servo.ai < 1) rtOpts->servo.ai = 1;
 
 	DBG("event POWER UP\n");
 
-	ETH_PTPStart(ETH_PTP_FineUpdate);
+	/* GNSS time is distributed in the PTP timescale, the PPS is timestamped on an auxiliary input */
+	if (rtOpts->gnss)
+	{
+		rtOpts->ptpTimescale = TRUE;
+		rtOpts->snapshotInputs |= (1 << rtOpts->gnssPpsInput);
+		gnssInit(ptpClock);
+	}
 
 	toState(ptpClock, PTP_INITIALIZING);
 
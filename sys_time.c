@@ -85,6 +85,7 @@ void setTime(const TimeInternal *time)
 	ts.tv_sec = time->seconds;
 	ts.tv_nsec = time->nanoseconds;
 	ETH_PTPTime_SetTime(&ts);
+	ppsRealign();
 	DBG("resetting system clock to %d sec %d nsec\n", time->seconds, time->nanoseconds);
 }
 
@@ -99,6 +100,7 @@ void updateTime(const TimeInternal *time)
 
 	/* Coarse update method */
 	ETH_PTPTime_UpdateOffset(&timeoffset);
+	ppsRealign();
 	DBGV("updateTime: updated\n");
 }
 
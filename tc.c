@@ -0,0 +1,278 @@
+/* tc.c */
+
+#include "ptpd.h"
+
+#ifdef PTPD_TRANSPARENT_CLOCK
+
+/* End-to-end transparent clock (11.5). Every message received on a port is
+ * relayed to the other ports. The residence time of an event message, from
+ * its ingress to its egress timestamp, is added to the correctionField of the
+ * message that completes it: the Follow_Up of a Sync, the Delay_Resp of a
+ * Delay_Req, the Pdelay_Resp of a Pdelay_Req and the Pdelay_Resp_Follow_Up of
+ * a Pdelay_Resp. A one-step Sync is relayed as a two-step Sync followed by a
+ * generated Follow_Up. */
+
+void tcInit(TransparentClock *tc)
+{
+	DBG("tcInit\n");
+
+	memset(tc, 0, sizeof(TransparentClock));
+}
+
+static ResidenceRecord *tcFindRecord(TransparentClock *tc, enum4bit_t messageType, int16_t sequenceId,
+																		 const PortIdentity *identity, int16_t ingressPort, int16_t egressPort)
+{
+	int16_t i;
+
+	for (i = 0; i < TC_RESIDENCE_RECORDS; i++)
+	{
+		if (tc->records[i].valid && tc->records[i].messageType == messageType && tc->records[i].sequenceId == sequenceId &&
+				tc->records[i].ingressPort == ingressPort && tc->records[i].egressPort == egressPort &&
+				isSamePortIdentity(&tc->records[i].identity, identity))
+		{
+			return &tc->records[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Store the residence of an event, the oldest record is replaced */
+static void tcAddRecord(TransparentClock *tc, const MsgHeader *header, const PortIdentity *identity,
+												int16_t ingressPort, int16_t egressPort, const TimeInternal *ingress, int64_t residence)
+{
+	ResidenceRecord *record = &tc->records[tc->i];
+
+	record->valid = TRUE;
+	record->messageType = header->messageType;
+	record->sequenceId = header->sequenceId;
+	record->identity = *identity;
+	record->ingressPort = ingressPort;
+	record->egressPort = egressPort;
+	record->ingress = *ingress;
+	record->correction = header->correctionfield;
+	record->residence = residence;
+
+	tc->i = (tc->i + 1) % TC_RESIDENCE_RECORDS;
+}
+
+/* Residence time in scaled nanoseconds, converted to the master time base */
+static int64_t tcResidence(const TransparentClock *tc, const TimeInternal *ingress, const TimeInternal *egress)
+{
+	TimeInternal residence;
+	int64_t scaled;
+
+	subTime(&residence, egress, ingress);
+	if (residence.seconds != 0 || residence.nanoseconds < 0)
+	{
+		ERROR("tcResidence: invalid residence time %d sec %d nsec\n", residence.seconds, residence.nanoseconds);
+		return 0;
+	}
+
+	scaled = (int64_t)residence.nanoseconds << 16;
+
+	/* Up to 2^46 times 10^6 ppb would overflow, split the product at the second */
+	return scaled + scaled / 1000000000 * tc->rateRatioPpb + scaled % 1000000000 * tc->rateRatioPpb / 1000000000;
+}
+
+/* Rate ratio of the master to the local clock from successive Syncs */
+static void tcRateRatio(TransparentClock *tc, const TimeInternal *ingress, const TimeInternal *origin)
+{
+	TimeInternal masterInterval, localInterval;
+	int64_t master, local, ppb;
+
+	if (tc->syncValid)
+	{
+		subTime(&masterInterval, origin, &tc->syncOrigin);
+		subTime(&localInterval, ingress, &tc->syncIngress);
+
+		master = (int64_t)masterInterval.seconds * 1000000000 + masterInterval.nanoseconds;
+		local = (int64_t)localInterval.seconds * 1000000000 + localInterval.nanoseconds;
+
+		/* A step of the master, or a Sync too old to compare, is ignored before the product overflows */
+		if (local > 0 && local < TC_RATE_INTERVAL_MAX_NS &&
+				llabs(master - local) < local / (1000000000 / TC_MAX_RATE_RATIO_PPB))
+		{
+			ppb = (master - local) * 1000000000 / local;
+			tc->rateRatioPpb += ((int32_t)ppb - tc->rateRatioPpb) >> TC_RATE_RATIO_S;
+			DBGV("tcRateRatio: %d ppb\n", tc->rateRatioPpb);
+		}
+	}
+
+	tc->syncIngress = *ingress;
+	tc->syncOrigin = *origin;
+	tc->syncValid = TRUE;
+}
+
+/* Origin time of a Sync in the master time base */
+static void tcSyncOrigin(const octet_t *buf, int64_t correction, TimeInternal *origin)
+{
+	MsgFollowUp follow;
+	TimeInternal correctionField;
+
+	/* originTimestamp and preciseOriginTimestamp share the same place */
+	msgUnpackFollowUp(buf, &follow);
+	toInternalTime(origin, &follow.preciseOriginTimestamp);
+	scaledNanosecondsToInternalTime(&correction, &correctionField);
+	addTime(origin, origin, &correctionField);
+}
+
+/* The event whose residence completes the message in buf, NULL if there is none.
+ * A follow-up takes the path of its event, a response the reverse path of its request. */
+static ResidenceRecord *tcCompletedEvent(TransparentClock *tc, const MsgHeader *header, const octet_t *buf,
+																				 int16_t ingressPort, int16_t egressPort)
+{
+	union
+	{
+		MsgDelayResp resp;
+		MsgPDelayResp presp;
+		MsgPDelayRespFollowUp prespfollow;
+	} msg;
+
+	switch (header->messageType)
+	{
+		case FOLLOW_UP:
+			return tcFindRecord(tc, SYNC, header->sequenceId, &header->sourcePortIdentity, ingressPort, egressPort);
+
+		case DELAY_RESP:
+			msgUnpackDelayResp(buf, &msg.resp);
+			return tcFindRecord(tc, DELAY_REQ, header->sequenceId, &msg.resp.requestingPortIdentity, egressPort, ingressPort);
+
+		case PDELAY_RESP:
+			msgUnpackPDelayResp(buf, &msg.presp);
+			return tcFindRecord(tc, PDELAY_REQ, header->sequenceId, &msg.presp.requestingPortIdentity, egressPort, ingressPort);
+
+		case PDELAY_RESP_FOLLOW_UP:
+			msgUnpackPDelayRespFollowUp(buf, &msg.prespfollow);
+			return tcFindRecord(tc, PDELAY_RESP, header->sequenceId, &msg.prespfollow.requestingPortIdentity, ingressPort, egressPort);
+
+		default:
+			return NULL;
+	}
+}
+
+/* Key of the residence record of an event: the requester for a Pdelay_Resp, the sender otherwise */
+static void tcEventIdentity(const MsgHeader *header, const octet_t *buf, PortIdentity *identity)
+{
+	MsgPDelayResp presp;
+
+	if (header->messageType == PDELAY_RESP)
+	{
+		msgUnpackPDelayResp(buf, &presp);
+		*identity = presp.requestingPortIdentity;
+	}
+	else
+	{
+		*identity = header->sourcePortIdentity;
+	}
+}
+
+static void tcSend(PtpClock *port, const MsgHeader *header, const octet_t *buf, int16_t length, TimeInternal *egress)
+{
+	switch (header->messageType)
+	{
+		case SYNC:
+		case DELAY_REQ:
+			netSendEvent(&port->netPath, buf, length, egress, NULL);
+			break;
+
+		case PDELAY_REQ:
+		case PDELAY_RESP:
+			netSendPeerEvent(&port->netPath, buf, length, egress);
+			break;
+
+		case PDELAY_RESP_FOLLOW_UP:
+			netSendPeerGeneral(&port->netPath, buf, length);
+			break;
+
+		default:
+			netSendGeneral(&port->netPath, buf, length, NULL);
+			break;
+	}
+
+	if (egress != NULL) addTime(egress, egress, &port->outboundLatency);
+}
+
+/* Relay the message in msgIbuf to the other ports, ingress is its receive timestamp */
+void tcForward(PtpClock *ptpClock, const TimeInternal *ingress)
+{
+	TransparentClock *tc = ptpClock->tc;
+	const MsgHeader *header = &ptpClock->msgTmpHeader;
+	ResidenceRecord *record;
+	PortIdentity identity;
+	TimeInternal ingressTime, egress, origin;
+	octet_t followUp[FOLLOW_UP_LENGTH];
+	bool  event, oneStep;
+	int16_t i, length;
+	PtpClock *port;
+
+	/* Never relay what one of our ports sent */
+	if (!memcmp(header->sourcePortIdentity.clockIdentity, ptpClock->defaultDS.clockIdentity, CLOCK_IDENTITY_LENGTH)) return;
+
+	length = ptpClock->msgIbufLength;
+	event = (bool)(header->messageType < FOLLOW_UP);
+	oneStep = (bool)(header->messageType == SYNC && !getFlag(header->flagField[0], FLAG0_TWO_STEP));
+
+	subTime(&ingressTime, ingress, &ptpClock->inboundLatency);
+	tcEventIdentity(header, ptpClock->msgIbuf, &identity);
+
+	if (oneStep)
+	{
+		tcSyncOrigin(ptpClock->msgIbuf, header->correctionfield, &origin);
+		tcRateRatio(tc, &ingressTime, &origin);
+	}
+
+	for (i = 0; i < NUMBER_PORTS; i++)
+	{
+		port = &ptpClock->ports[i];
+		if (port == ptpClock) continue;
+
+		switch (port->portDS.portState)
+		{
+			case PTP_INITIALIZING:
+			case PTP_FAULTY:
+			case PTP_DISABLED:
+				continue;
+
+			default:
+				break;
+		}
+
+		memcpy(tc->buf, ptpClock->msgIbuf, length);
+
+		/* Complete the message with the residence of its event */
+		record = tcCompletedEvent(tc, header, tc->buf, ptpClock->portDS.portIdentity.portNumber, port->portDS.portIdentity.portNumber);
+		if (record != NULL)
+		{
+			if (header->messageType == FOLLOW_UP)
+			{
+				tcSyncOrigin(tc->buf, record->correction + header->correctionfield, &origin);
+				tcRateRatio(tc, &record->ingress, &origin);
+			}
+
+			msgAddCorrection(tc->buf, record->residence);
+			record->valid = FALSE;
+		}
+
+		/* A two-step transparent clock turns a one-step Sync into a two-step one */
+		if (oneStep) setFlag(*(uint8_t*)(tc->buf + 6), FLAG0_TWO_STEP);
+
+		tcSend(port, header, tc->buf, length, event ? &egress : NULL);
+
+		if (!event) continue;
+
+		if (oneStep)
+		{
+			msgPackFollowUpFromSync(followUp, ptpClock->msgIbuf);
+			msgAddCorrection(followUp, tcResidence(tc, &ingressTime, &egress));
+			netSendGeneral(&port->netPath, followUp, FOLLOW_UP_LENGTH, NULL);
+		}
+		else
+		{
+			tcAddRecord(tc, header, &identity, ptpClock->portDS.portIdentity.portNumber, port->portDS.portIdentity.portNumber,
+									&ingressTime, tcResidence(tc, &ingressTime, &egress));
+		}
+	}
+}
+
+#endif
@@ -2,62 +2,96 @@
 
 #include "../ptpd.h"
 
-/* An array to hold the various system timer handles. */
-volatile uint16_t ptpdTimers[TIMER_ARRAY_SIZE];
-volatile uint16_t ptpdTimersCounter[TIMER_ARRAY_SIZE];
-volatile bool ptpdTimersExpired[TIMER_ARRAY_SIZE];
- 
-void initTimer(void)
+/* Milliseconds since startup, wraps after 49 days */
+static volatile uint32_t timerMs;
+
+void initTimer(IntervalTimer *itimer)
 {
 	int32_t i;
 
 	DBG("initTimer\n");
 
 	/* Create the various timers used in the system. */
-  for (i = 0; i < TIMER_ARRAY_SIZE; i++)
-  {
+	for (i = 0; i < TIMER_ARRAY_SIZE; i++)
+	{
 		// Mark the timer as not expired.
 		// Initialize the timer.
-		ptpdTimers[i] = 0;
-		ptpdTimersCounter[i] = 0;
-		ptpdTimersExpired[i] = FALSE;
+		itimer[i].interval = 0;
+		itimer[i].left = 0;
+		itimer[i].expired = FALSE;
+	}
+}
+
+/* Advance the timers of one instance by elapsed_us, called from the system tick */
+void timerUpdate(IntervalTimer *itimer, uint32_t elapsed_us)
+{
+	int32_t i;
+	uint32_t late;
+
+	for (i = 0; i < TIMER_ARRAY_SIZE; i++)
+	{
+		if (itimer[i].interval == 0) continue;
+
+		if (itimer[i].left > elapsed_us)
+		{
+			itimer[i].left -= elapsed_us;
+			continue;
+		}
+
+		// Reload the periodic timer and flag the expiry, the part of the
+		// tick past the expiry is taken from the next period so an interval
+		// shorter than a tick keeps its mean rate.
+		late = (elapsed_us - itimer[i].left) % itimer[i].interval;
+		itimer[i].left = itimer[i].interval - late;
+		itimer[i].expired = TRUE;
 	}
 }
 
-void timerStop(int32_t index)
+/* Advance the monotonic time by elapsed_ms, called once from the system tick */
+void timerTick(uint32_t elapsed_ms)
+{
+	timerMs += elapsed_ms;
+}
+
+/* Monotonic time in ms, unlike getTime it never steps with the clock */
+uint32_t timerNow(void)
+{
+	return timerMs;
+}
+
+void timerStop(int32_t index, IntervalTimer *itimer)
 {
 	/* Sanity check the index. */
 	if (index >= TIMER_ARRAY_SIZE) return;
 
 	// Cancel the timer and reset the expired flag.
 	DBGV("timerStop: stop timer %d\n", index);
-	ptpdTimers[index] = 0;
-	ptpdTimersCounter[index] = 0;
-	ptpdTimersExpired[index] = FALSE;
+	itimer[index].interval = 0;
+	itimer[index].left = 0;
+	itimer[index].expired = FALSE;
 }
 
-void timerStart(int32_t index, uint32_t interval_ms)
+void timerStart(int32_t index, uint32_t interval_us, IntervalTimer *itimer)
 {
 	/* Sanity check the index. */
 	if (index >= TIMER_ARRAY_SIZE) return;
 
 	// Set the timer duration and start the timer.
-	DBGV("timerStart: set timer %d to %d\n", index, interval_ms);
-	ptpdTimersExpired[index] = FALSE;
-	ptpdTimers[index] = interval_ms;
-	ptpdTimersCounter[index] = interval_ms;
+	DBGV("timerStart: set timer %d to %u usec\n", index, interval_us);
+	itimer[index].expired = FALSE;
+	itimer[index].left = interval_us;
+	itimer[index].interval = interval_us;
 }
 
-bool timerExpired(int32_t index)
+bool timerExpired(int32_t index, IntervalTimer *itimer)
 {
 	/* Sanity check the index. */
 	if (index >= TIMER_ARRAY_SIZE) return FALSE;
 
 	/* Determine if the timer expired. */
-	if (!ptpdTimersExpired[index]) return FALSE;
+	if (!itimer[index].expired) return FALSE;
 	DBGV("timerExpired: timer %d expired\n", index);
-	ptpdTimersExpired[index] = FALSE;
+	itimer[index].expired = FALSE;
 
 	return TRUE;
 }
-
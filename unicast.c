@@ -0,0 +1,509 @@
+/* unicast.c */
+
+#include "ptpd.h"
+
+/* Unicast message negotiation (16.1). A slave asks the master configured in
+ * rtOpts->unicastAddress for Announce, Sync and Delay_Resp messages with
+ * REQUEST_UNICAST_TRANSMISSION TLVs and renews each grant during its last
+ * quarter. A master keeps the grants it gave in a table and sends every
+ * grantee its messages at the granted interval, instead of multicasting them.
+ * Sync and Delay_Resp are only asked while that master is the parent, the
+ * Announce always, for the BMC. A grant which stops early is cancelled, and
+ * the CANCEL sent again until the other end acknowledges it. */
+
+static const enum4bit_t unicastMessageTypes[UNICAST_REQUESTS] = { ANNOUNCE, SYNC, DELAY_RESP };
+
+static const PortIdentity unicastAllPorts =
+{
+	{ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, (int16_t)0xFFFF
+};
+
+void unicastInit(PtpClock *ptpClock)
+{
+	RunTimeOpts *rtOpts = ptpClock->rtOpts;
+	UnicastGrant *request;
+	ip_addr_t master;
+	int16_t i;
+
+	memset(ptpClock->unicastGrants, 0, sizeof(ptpClock->unicastGrants));
+	memset(ptpClock->unicastRequests, 0, sizeof(ptpClock->unicastRequests));
+	ptpClock->unicastRequesting = FALSE;
+
+	if (!rtOpts->unicastNegotiation) return;
+
+	DBG("unicastInit\n");
+
+	timerStart(UNICAST_GRANT_TIMER, 1000000, ptpClock->itimer);
+
+	if (rtOpts->unicastAddress[0] == '\0') return;
+
+	if (!ipaddr_aton((const char *) rtOpts->unicastAddress, &master))
+	{
+		ERROR("unicastInit: failed to encode unicast address: %s\n", rtOpts->unicastAddress);
+		return;
+	}
+
+	for (i = 0; i < UNICAST_REQUESTS; i++)
+	{
+		request = &ptpClock->unicastRequests[i];
+		request->messageType = unicastMessageTypes[i];
+		request->portIdentity = unicastAllPorts;
+		ip_addr_copy(request->addr, master);
+
+		switch (request->messageType)
+		{
+			case ANNOUNCE:
+				request->logInterval = rtOpts->announceInterval;
+				break;
+			case SYNC:
+				request->logInterval = rtOpts->syncInterval;
+				break;
+			default:
+				request->logInterval = DEFAULT_DELAYREQ_INTERVAL;
+				break;
+		}
+	}
+
+	ptpClock->unicastRequesting = TRUE;
+}
+
+/* Send the Signaling message packed in msgObuf */
+static void unicastSend(PtpClock *ptpClock, const ip_addr_t *addr)
+{
+	int16_t length = flip16(*(int16_t*)(ptpClock->msgObuf + 2));
+
+	msgPackUnicastFlag(ptpClock->msgObuf, TRUE);
+
+	if (!netSendGeneral(&ptpClock->netPath, ptpClock->msgObuf, length, addr))
+	{
+		ERROR("unicastSend: can't sent\n");
+	}
+	else
+	{
+		DBGV("unicastSend\n");
+		ptpClock->sentSignalingSequenceId++;
+	}
+}
+
+/* Append a TLV to the Signaling message for the master, packed by the first one */
+static void unicastAppend(PtpClock *ptpClock, const MsgUnicastTLV *tlv, bool *pending)
+{
+	if (!*pending)
+	{
+		msgPackSignaling(ptpClock, ptpClock->msgObuf, &unicastAllPorts);
+		*pending = TRUE;
+	}
+
+	msgPackUnicastTLV(ptpClock->msgObuf, tlv);
+}
+
+/* Send the CANCEL of a grant given to a slave port */
+static void unicastSendCancel(PtpClock *ptpClock, const UnicastGrant *grant)
+{
+	MsgUnicastTLV tlv;
+
+	DBG("unicastSendCancel: message %d to port %d\n", grant->messageType, grant->portIdentity.portNumber);
+
+	msgPackSignaling(ptpClock, ptpClock->msgObuf, &grant->portIdentity);
+	tlv.tlvType = CANCEL_UNICAST_TRANSMISSION;
+	tlv.messageType = grant->messageType;
+	msgPackUnicastTLV(ptpClock->msgObuf, &tlv);
+	unicastSend(ptpClock, &grant->addr);
+}
+
+/* The parent is the master asked, its Sync and Delay_Resp are of use */
+static bool  unicastFollowing(const PtpClock *ptpClock)
+{
+	if (ptpClock->portDS.portState != PTP_SLAVE && ptpClock->portDS.portState != PTP_UNCALIBRATED) return FALSE;
+
+	return (bool)(ptpClock->parentAddrKnown &&
+			isSamePortIdentity(&ptpClock->parentAddrIdentity, &ptpClock->parentDS.parentPortIdentity) &&
+			ip_addr_cmp(&ptpClock->parentAddr, &ptpClock->unicastRequests[0].addr));
+}
+
+void unicastService(PtpClock *ptpClock)
+{
+	MsgUnicastTLV tlv;
+	UnicastGrant *grant;
+	bool  pending = FALSE;
+	bool  following;
+	int16_t i;
+
+	if (!timerExpired(UNICAST_GRANT_TIMER, ptpClock->itimer)) return;
+
+	/* The grants of a master expire unless the slave renews them */
+	for (i = 0; i < UNICAST_MAX_GRANTS; i++)
+	{
+		grant = &ptpClock->unicastGrants[i];
+
+		if (grant->cancel > 0)
+		{
+			grant->cancel--;
+			unicastSendCancel(ptpClock, grant);
+			continue;
+		}
+
+		if (!grant->granted) continue;
+
+		if (--grant->left == 0)
+		{
+			DBG("unicastService: grant of message %d to port %d expired\n", grant->messageType, grant->portIdentity.portNumber);
+			grant->granted = FALSE;
+		}
+	}
+
+	if (!ptpClock->unicastRequesting) return;
+
+	following = unicastFollowing(ptpClock);
+
+	/* Ask for what was denied, expired or is in the last quarter of its grant */
+	for (i = 0; i < UNICAST_REQUESTS; i++)
+	{
+		grant = &ptpClock->unicastRequests[i];
+
+		if (grant->granted && --grant->left == 0)
+		{
+			DBG("unicastService: grant of message %d expired\n", grant->messageType);
+			grant->granted = FALSE;
+		}
+
+		/* Another parent, or no longer a slave, the master can stop sending */
+		if (grant->messageType != ANNOUNCE && !following)
+		{
+			if (grant->granted)
+			{
+				DBG("unicastService: cancel message %d\n", grant->messageType);
+				grant->granted = FALSE;
+				grant->cancel = UNICAST_CANCEL_RETRIES;
+			}
+
+			if (grant->cancel > 0)
+			{
+				grant->cancel--;
+				tlv.tlvType = CANCEL_UNICAST_TRANSMISSION;
+				tlv.messageType = grant->messageType;
+				unicastAppend(ptpClock, &tlv, &pending);
+			}
+
+			continue;
+		}
+
+		/* A new request replaces the cancel */
+		grant->cancel = 0;
+
+		if (grant->count > 0)
+		{
+			grant->count--;
+			continue;
+		}
+
+		if (grant->granted && grant->left > grant->duration / 4) continue;
+
+		tlv.tlvType = REQUEST_UNICAST_TRANSMISSION;
+		tlv.messageType = grant->messageType;
+		tlv.logInterMessagePeriod = grant->logInterval;
+		tlv.durationField = ptpClock->rtOpts->unicastGrantDuration;
+		tlv.renewalInvited = FALSE;
+		unicastAppend(ptpClock, &tlv, &pending);
+
+		grant->count = UNICAST_RETRY_S;
+	}
+
+	if (pending) unicastSend(ptpClock, &ptpClock->unicastRequests[0].addr);
+}
+
+void unicastRevoke(PtpClock *ptpClock)
+{
+	UnicastGrant *grant;
+	int16_t i;
+
+	for (i = 0; i < UNICAST_MAX_GRANTS; i++)
+	{
+		grant = &ptpClock->unicastGrants[i];
+		if (!grant->granted) continue;
+
+		grant->granted = FALSE;
+		grant->cancel = UNICAST_CANCEL_RETRIES - 1;
+		unicastSendCancel(ptpClock, grant);
+	}
+}
+
+void unicastShutdown(PtpClock *ptpClock)
+{
+	MsgUnicastTLV tlv;
+	UnicastGrant *grant;
+	bool  pending = FALSE;
+	int16_t i;
+
+	if (!ptpClock->rtOpts->unicastNegotiation) return;
+
+	/* No retry, a single CANCEL each */
+	for (i = 0; i < UNICAST_MAX_GRANTS; i++)
+	{
+		grant = &ptpClock->unicastGrants[i];
+		if (!grant->granted && grant->cancel == 0) continue;
+
+		grant->granted = FALSE;
+		grant->cancel = 0;
+		unicastSendCancel(ptpClock, grant);
+	}
+
+	for (i = 0; ptpClock->unicastRequesting && i < UNICAST_REQUESTS; i++)
+	{
+		grant = &ptpClock->unicastRequests[i];
+		if (!grant->granted && grant->cancel == 0) continue;
+
+		grant->granted = FALSE;
+		grant->cancel = 0;
+		tlv.tlvType = CANCEL_UNICAST_TRANSMISSION;
+		tlv.messageType = grant->messageType;
+		unicastAppend(ptpClock, &tlv, &pending);
+	}
+
+	if (pending) unicastSend(ptpClock, &ptpClock->unicastRequests[0].addr);
+}
+
+UnicastGrant *unicastFindGrant(PtpClock *ptpClock, const PortIdentity *portIdentity, enum4bit_t messageType)
+{
+	int16_t i;
+
+	for (i = 0; i < UNICAST_MAX_GRANTS; i++)
+	{
+		if (ptpClock->unicastGrants[i].granted && ptpClock->unicastGrants[i].messageType == messageType &&
+				isSamePortIdentity(&ptpClock->unicastGrants[i].portIdentity, portIdentity))
+		{
+			return &ptpClock->unicastGrants[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* The port sends every 2^(logInterval - logPortInterval) intervals to the grantee */
+bool  unicastGrantDue(UnicastGrant *grant, enum4bit_t messageType, int8_t logPortInterval)
+{
+	int16_t ratio;
+
+	if (!grant->granted || grant->messageType != messageType) return FALSE;
+
+	if (grant->count > 0)
+	{
+		grant->count--;
+		return FALSE;
+	}
+
+	ratio = grant->logInterval - logPortInterval;
+	grant->count = (ratio > 0) ? (1 << min(ratio, 14)) - 1 : 0;
+
+	return TRUE;
+}
+
+const ip_addr_t *unicastMaster(const PtpClock *ptpClock)
+{
+	return ptpClock->unicastRequesting ? &ptpClock->unicastRequests[0].addr : NULL;
+}
+
+/* Grant or deny the request of the slave port at addr */
+static void unicastGrantRequest(PtpClock *ptpClock, const MsgUnicastTLV *request, const ip_addr_t *addr, MsgUnicastTLV *reply)
+{
+	const PortIdentity *slave = &ptpClock->msgTmpHeader.sourcePortIdentity;
+	UnicastGrant *grant;
+	int16_t i;
+
+	reply->tlvType = GRANT_UNICAST_TRANSMISSION;
+	reply->messageType = request->messageType;
+	reply->logInterMessagePeriod = request->logInterMessagePeriod;
+	reply->durationField = 0;
+	reply->renewalInvited = FALSE;
+
+	if (ptpClock->defaultDS.slaveOnly || request->durationField == 0) return;
+
+	/* Messages leave on the intervals of the port, a grantee can only get fewer of them */
+	switch (request->messageType)
+	{
+		case ANNOUNCE:
+			if (request->logInterMessagePeriod < ptpClock->portDS.logAnnounceInterval) return;
+			break;
+		case SYNC:
+			if (request->logInterMessagePeriod < ptpClock->portDS.logSyncInterval) return;
+			break;
+		case DELAY_RESP:
+			break;
+		default:
+			return;
+	}
+
+	grant = unicastFindGrant(ptpClock, slave, request->messageType);
+
+	for (i = 0; grant == NULL && i < UNICAST_MAX_GRANTS; i++)
+	{
+		if (!ptpClock->unicastGrants[i].granted && ptpClock->unicastGrants[i].cancel == 0) grant = &ptpClock->unicastGrants[i];
+	}
+
+	if (grant == NULL)
+	{
+		ERROR("unicastGrantRequest: grant table full\n");
+		return;
+	}
+
+	grant->granted = TRUE;
+	grant->portIdentity = *slave;
+	ip_addr_copy(grant->addr, *addr);
+	grant->messageType = request->messageType;
+	grant->logInterval = request->logInterMessagePeriod;
+	grant->duration = min(request->durationField, UNICAST_GRANT_DURATION_MAX);
+	grant->left = grant->duration;
+	grant->count = 0;
+	grant->cancel = 0;
+
+	DBG("unicastGrantRequest: message %d to port %d for %d s\n", grant->messageType, slave->portNumber, grant->duration);
+
+	reply->durationField = grant->duration;
+	reply->renewalInvited = TRUE;
+}
+
+/* The master answered one of our requests */
+static void unicastGranted(PtpClock *ptpClock, const MsgUnicastTLV *tlv, const ip_addr_t *addr)
+{
+	UnicastGrant *request;
+	int16_t i;
+
+	for (i = 0; i < UNICAST_REQUESTS; i++)
+	{
+		request = &ptpClock->unicastRequests[i];
+		if (request->messageType != tlv->messageType || !ip_addr_cmp(&request->addr, addr)) continue;
+
+		if (tlv->durationField == 0)
+		{
+			DBG("unicastGranted: message %d denied\n", tlv->messageType);
+			request->granted = FALSE;
+			return;
+		}
+
+		request->granted = TRUE;
+		request->logInterval = tlv->logInterMessagePeriod;
+		request->duration = tlv->durationField;
+		request->left = tlv->durationField;
+		request->count = 0;
+		return;
+	}
+}
+
+/* The other end stops a grant, given or received */
+static void unicastCancel(PtpClock *ptpClock, const MsgUnicastTLV *tlv, const ip_addr_t *addr)
+{
+	UnicastGrant *grant;
+	int16_t i;
+
+	grant = unicastFindGrant(ptpClock, &ptpClock->msgTmpHeader.sourcePortIdentity, tlv->messageType);
+	if (grant != NULL) grant->granted = FALSE;
+
+	for (i = 0; ptpClock->unicastRequesting && i < UNICAST_REQUESTS; i++)
+	{
+		grant = &ptpClock->unicastRequests[i];
+		if (grant->messageType == tlv->messageType && ip_addr_cmp(&grant->addr, addr))
+		{
+			grant->granted = FALSE;
+			grant->count = UNICAST_RETRY_S;
+		}
+	}
+}
+
+/* The other end acknowledged our CANCEL, stop sending it */
+static void unicastCancelled(PtpClock *ptpClock, const MsgUnicastTLV *tlv, const ip_addr_t *addr)
+{
+	UnicastGrant *grant;
+	int16_t i;
+
+	for (i = 0; i < UNICAST_MAX_GRANTS; i++)
+	{
+		grant = &ptpClock->unicastGrants[i];
+		if (grant->cancel > 0 && grant->messageType == tlv->messageType &&
+				isSamePortIdentity(&grant->portIdentity, &ptpClock->msgTmpHeader.sourcePortIdentity))
+		{
+			grant->cancel = 0;
+		}
+	}
+
+	for (i = 0; ptpClock->unicastRequesting && i < UNICAST_REQUESTS; i++)
+	{
+		grant = &ptpClock->unicastRequests[i];
+		if (grant->messageType == tlv->messageType && ip_addr_cmp(&grant->addr, addr)) grant->cancel = 0;
+	}
+}
+
+void unicastSignaling(PtpClock *ptpClock)
+{
+	MsgSignaling *signaling = &ptpClock->msgTmp.signaling;
+	MsgUnicastTLV tlv, reply;
+	MsgIntervalTLV interval;
+	ip_addr_t source;
+	bool  pending = FALSE;
+	int16_t offset, tlvOffset;
+
+	msgUnpackSignaling(ptpClock->msgIbuf, signaling);
+
+	/* Addressed to all the ports, to all the ports of this clock or to this port */
+	if (memcmp(signaling->targetPortIdentity.clockIdentity, unicastAllPorts.clockIdentity, CLOCK_IDENTITY_LENGTH) &&
+			memcmp(signaling->targetPortIdentity.clockIdentity, ptpClock->portDS.portIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH))
+	{
+		DBGV("unicastSignaling: not for this clock\n");
+		return;
+	}
+
+	if (signaling->targetPortIdentity.portNumber != unicastAllPorts.portNumber &&
+			signaling->targetPortIdentity.portNumber != ptpClock->portDS.portIdentity.portNumber)
+	{
+		DBGV("unicastSignaling: not for this port\n");
+		return;
+	}
+
+	ip_addr_copy(source, ptpClock->netPath.lastRecvAddr);
+
+	/* Every TLV needing an answer gets it in a single reply */
+	msgPackSignaling(ptpClock, ptpClock->msgObuf, &ptpClock->msgTmpHeader.sourcePortIdentity);
+
+	for (tlvOffset = SIGNALING_LENGTH;
+			(offset = msgUnpackUnicastTLV(ptpClock->msgIbuf, tlvOffset, ptpClock->msgIbufLength, &tlv)) > 0;
+			tlvOffset = offset)
+	{
+		if (tlv.tlvType == ORGANIZATION_EXTENSION)
+		{
+			if (msgUnpackIntervalTLV(ptpClock->msgIbuf, tlvOffset, &interval)) intervalSignaling(ptpClock, &interval);
+			continue;
+		}
+
+		if (!ptpClock->rtOpts->unicastNegotiation) continue;
+
+		switch (tlv.tlvType)
+		{
+			case REQUEST_UNICAST_TRANSMISSION:
+				unicastGrantRequest(ptpClock, &tlv, &source, &reply);
+				msgPackUnicastTLV(ptpClock->msgObuf, &reply);
+				pending = TRUE;
+				break;
+
+			case GRANT_UNICAST_TRANSMISSION:
+				unicastGranted(ptpClock, &tlv, &source);
+				break;
+
+			case CANCEL_UNICAST_TRANSMISSION:
+				unicastCancel(ptpClock, &tlv, &source);
+				reply.tlvType = ACKNOWLEDGE_CANCEL_UNICAST_TRANSMISSION;
+				reply.messageType = tlv.messageType;
+				msgPackUnicastTLV(ptpClock->msgObuf, &reply);
+				pending = TRUE;
+				break;
+
+			case ACKNOWLEDGE_CANCEL_UNICAST_TRANSMISSION:
+				unicastCancelled(ptpClock, &tlv, &source);
+				break;
+
+			default:
+				DBGV("unicastSignaling: ignore TLV type %d\n", tlv.tlvType);
+				break;
+		}
+	}
+
+	if (pending) unicastSend(ptpClock, &source);
+}